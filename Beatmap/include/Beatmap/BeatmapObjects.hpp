@@ -136,6 +136,10 @@ struct ObjectTypeData_Button
 	// Playback volume of the sample
 	float sampleVolume = 1.0;
 
+	// Set on normal chips that are placed at the same time as an FX chip on the same side
+	// these are drawn narrower so the FX chip stays visible, calculated by BeatmapPlayback::Reset
+	bool overlapsFXChip = false;
+
 	static const ObjectType staticType = ObjectType::Single;
 };
 // A Hold button, extends a normal button with duration and effect type
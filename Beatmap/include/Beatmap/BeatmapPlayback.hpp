@@ -32,9 +32,11 @@ public:
 	// Removes any existing data and sets a special behaviour for calibration mode
 	void MakeCalibrationPlayback();
 
-	// Gets all linear objects that fall within the given time range:
-	//	<curr - keepObjectDuration, curr + range>
-	Vector<ObjectState*> GetObjectsInRange(MapTime range);
+	// Gets all renderable objects that fall within the given time range:
+	//	<curr - hittableObjectLeave, curr + range>
+	// Objects are returned in render order: fx holds, bt holds, fx chips, bt chips, lasers
+	// The returned vector is reused and only valid until the next call
+	const Vector<ObjectState*>& GetObjectsInRange(MapTime range);
 	// Duration for objects to keep being returned by GetObjectsInRange after they have passed the current time
 	MapTime keepObjectDuration = 1000;
 
@@ -54,7 +56,8 @@ public:
 	uint32 CountBeats(MapTime start, MapTime range, int32& startIndex, uint32 multiplier = 1) const;
 
 	// View coordinate conversions
-	// the input duration is looped throught the timing points that affect it and the resulting float is the number of 4th note offets
+	// the resulting float is the number of 4th note offsets, chart stops do not advance the view distance
+	// these are looked up in a table of cumulative view distances built on Reset
 	MapTime ViewDistanceToDuration(float distance);
 	float DurationToViewDistance(MapTime time);
 	float DurationToViewDistanceAtTime(MapTime time, MapTime duration);
@@ -110,7 +113,6 @@ private:
 	LaneHideTogglePoint** m_SelectLaneTogglePoint(MapTime time, bool allowReset = false);
 	ObjectState** m_SelectHitObject(MapTime time, bool allowReset = false);
 	ZoomControlPoint** m_SelectZoomObject(MapTime time);
-	Vector<ChartStop*> m_SelectChartStops(MapTime time, MapTime duration);
 
 	// End object pointer, this is not a valid pointer, but points to the element after the last element
 	bool IsEndTiming(TimingPoint** obj);
@@ -118,6 +120,28 @@ private:
 	bool IsEndLaneToggle(LaneHideTogglePoint ** obj);
 	bool IsEndZoomPoint(ZoomControlPoint** obj);
 
+	// A point where the rate at which the view distance advances changes
+	// the view distance between two points is linear
+	struct ViewDistancePoint
+	{
+		MapTime time;
+		// Cumulative view distance at this point
+		double distance;
+		// View distance advanced per ms after this point
+		double rate;
+	};
+
+	// Builds the cumulative view distance tables used by the view coordinate conversions
+	void m_BuildViewDistanceTables();
+	void m_BuildViewDistanceTable(Vector<ViewDistancePoint>& table, bool includeStops);
+	double m_GetViewDistance(const Vector<ViewDistancePoint>& table, MapTime time) const;
+	MapTime m_GetViewDistanceTime(const Vector<ViewDistancePoint>& table, double distance) const;
+
+	// Builds the render buckets used by GetObjectsInRange
+	void m_BuildRenderBuckets();
+	// Adds all objects in a render bucket that overlap <begin, end> to m_objectsInRange
+	void m_QueryRenderBucket(uint32 bucketIndex, MapTime begin, MapTime end);
+
 	// Current map position of this playback object
 	MapTime m_playbackTime;
 
@@ -149,6 +173,20 @@ private:
 	// Hold buttons with effects that are active
 	Set<ObjectState*> m_effectObjects;
 
+	// Cumulative view distance at every timing point, chart stop start and chart stop end
+	Vector<ViewDistancePoint> m_viewDistances;
+	// Cumulative view distance at every timing point, ignoring chart stops
+	Vector<ViewDistancePoint> m_viewDistancesNoStops;
+
+	// Renderable objects split up by render order, each sorted by starting time
+	static const uint32 m_numRenderBuckets = 5;
+	Vector<ObjectState*> m_renderBuckets[m_numRenderBuckets];
+	// Running maximum of the end times in each render bucket
+	//	this is non-decreasing so it can be binary searched for the first object that could still be visible
+	Vector<MapTime> m_renderBucketEndTimes[m_numRenderBuckets];
+	// Result of the last GetObjectsInRange call
+	Vector<ObjectState*> m_objectsInRange;
+
 	// Current state of events
 	Map<EventKey, EventData> m_eventMapping;
 
@@ -1,4 +1,5 @@
 #pragma once
+#include <mutex>
 
 /*
 	Compiled operation on local database object
@@ -46,8 +47,18 @@ public:
 	void Close();
 	bool Open(const String& path);
 	DBStatement Query(const String& queryString);
+	// Returns a statement that stays compiled for the lifetime of the connection
+	//	it is rewound before it is returned, but parameters keep their previous bindings
+	DBStatement& CachedQuery(const String& queryString);
 	bool Exec(const String& queryString);
 	bool ExecDirect(const String& queryString);
+	// Locks the connection and the statement cache when the database is shared between threads
+	//	statements may only be used, rewound or destroyed while this is held
+	std::unique_lock<std::recursive_mutex> Lock();
 
 	struct sqlite3* db = nullptr;
+
+private:
+	Map<String, DBStatement> m_statementCache;
+	std::recursive_mutex m_mutex;
 };
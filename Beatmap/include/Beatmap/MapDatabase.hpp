@@ -82,7 +82,17 @@ struct ChartIndex
 	int32 preview_length;
 	uint64 lwt;
 	int32 custom_offset = 0;
+	// Scores, best first
+	// Until all scores are loaded this only holds the ones that decide the best score and clear mark
 	Vector<ScoreIndex*> scores;
+	bool scoresLoaded = false;
+
+	// Loads every score of this chart from the database the first time it is called
+	Vector<ScoreIndex*>& GetAllScores();
+
+private:
+	class MapDatabase_Impl* m_database = nullptr;
+	friend class MapDatabase_Impl;
 };
 
 // Map located in database
@@ -184,7 +194,9 @@ public:
 	void FinishInit();
 
 	// Checks the background scanning and actualized the current map database
+	//	changes are applied for a limited time per call, call again while HasPendingChanges is true
 	void Update();
+	bool HasPendingChanges();
 
 	bool IsSearching() const;
 	void StartSearching();
@@ -2,6 +2,26 @@
 #include "BeatmapPlayback.hpp"
 #include "Shared/Profiling.hpp"
 
+// Render order buckets used by GetObjectsInRange
+enum RenderBucket : uint32
+{
+	RenderBucket_FXHold = 0,
+	RenderBucket_BTHold,
+	RenderBucket_FXChip,
+	RenderBucket_BTChip,
+	RenderBucket_Laser,
+};
+
+// Time at which an object stops being visible on the track
+static MapTime GetObjectEndTime(const MultiObjectState* obj)
+{
+	if (obj->type == ObjectType::Hold)
+		return obj->time + obj->hold.duration;
+	if (obj->type == ObjectType::Laser)
+		return obj->time + obj->laser.duration;
+	return obj->time;
+}
+
 BeatmapPlayback::BeatmapPlayback(Beatmap& beatmap) : m_beatmap(&beatmap)
 {
 }
@@ -56,6 +76,9 @@ bool BeatmapPlayback::Reset(MapTime initTime, MapTime start)
 	m_hittableObjects.clear();
 	m_holdObjects.clear();
 
+	m_BuildViewDistanceTables();
+	m_BuildRenderBuckets();
+
 	m_barTime = 0;
 	m_beatTime = 0;
 	m_initialEffectStateSent = false;
@@ -332,18 +355,16 @@ void BeatmapPlayback::MakeCalibrationPlayback()
 	calibrationTiming->numerator = 4;
 	m_timingPoints.Add(calibrationTiming);
 	m_currentTiming = &m_timingPoints.front();
+	m_chartStops.clear();
+	m_BuildViewDistanceTables();
 }
 
-Vector<ObjectState*> BeatmapPlayback::GetObjectsInRange(MapTime range)
+const Vector<ObjectState*>& BeatmapPlayback::GetObjectsInRange(MapTime range)
 {
-	static const uint32 earlyVisibility = 200;
-
-	const TimingPoint& tp = GetCurrentTimingPoint();
-
-	MapTime begin = (MapTime) (m_playbackTime - earlyVisibility);
+	MapTime begin = m_playbackTime - hittableObjectLeave;
 	MapTime end = m_playbackTime + range;
 
-	Vector<ObjectState*> ret;
+	m_objectsInRange.clear();
 
 	if (m_isCalibration) {
 		for (auto& o : m_calibrationObjects)
@@ -353,39 +374,107 @@ Vector<ObjectState*> BeatmapPlayback::GetObjectsInRange(MapTime range)
 			if (o->time > end)
 				break;
 
-			ret.Add(o);
+			m_objectsInRange.Add(o);
 		}
-		return ret;
+		return m_objectsInRange;
 	}
 
-	if (begin < m_viewRange.begin) begin = m_viewRange.begin;
 	if (m_viewRange.HasEnd() && end >= m_viewRange.end) end = m_viewRange.end;
 
-	// Add hold objects
-	for (auto& ho : m_holdObjects)
+	for (uint32 i = 0; i < m_numRenderBuckets; i++)
+	{
+		m_QueryRenderBucket(i, begin, end);
+	}
+
+	return m_objectsInRange;
+}
+
+void BeatmapPlayback::m_BuildRenderBuckets()
+{
+	for (uint32 i = 0; i < m_numRenderBuckets; i++)
 	{
-		ret.AddUnique(ho);
+		m_renderBuckets[i].clear();
+		m_renderBucketEndTimes[i].clear();
 	}
+	m_objectsInRange.clear();
 
-	// Iterator
-	ObjectState** obj = m_currentObj;
-	// Return all objects that lie after the currently queued object and fall within the given range
-	while (!IsEndObject(obj))
+	// Chips of the last processed tick, used to find normal chips that overlap FX chips
+	MapTime chipTime = std::numeric_limits<MapTime>::min();
+	Vector<MultiObjectState*> btChips;
+	bool fxChips[2] = { false, false };
+	auto MarkOverlappingChips = [&]()
 	{
-		if ((*obj)->time < begin)
+		for (MultiObjectState* bt : btChips)
+			bt->button.overlapsFXChip = fxChips[bt->button.index < 2 ? 0 : 1];
+		btChips.clear();
+		fxChips[0] = fxChips[1] = false;
+	};
+
+	// Objects are already sorted by time so every bucket stays sorted by starting time
+	for (ObjectState* obj : m_objects)
+	{
+		MultiObjectState* mobj = *obj;
+		uint32 bucket;
+		if (mobj->type == ObjectType::Single)
 		{
-			obj += 1;
-			continue;
+			if (mobj->time != chipTime)
+			{
+				MarkOverlappingChips();
+				chipTime = mobj->time;
+			}
+
+			if (mobj->button.index < 4)
+			{
+				btChips.Add(mobj);
+				bucket = RenderBucket_BTChip;
+			}
+			else
+			{
+				fxChips[mobj->button.index - 4] = true;
+				bucket = RenderBucket_FXChip;
+			}
 		}
+		else if (mobj->type == ObjectType::Hold)
+			bucket = mobj->hold.index < 4 ? RenderBucket_BTHold : RenderBucket_FXHold;
+		else if (mobj->type == ObjectType::Laser)
+			bucket = RenderBucket_Laser;
+		else
+			continue;
 
-		if ((*obj)->time >= end)
-			break; // No more objects
+		Vector<MapTime>& endTimes = m_renderBucketEndTimes[bucket];
+		MapTime endTime = GetObjectEndTime(mobj);
+		if (!endTimes.empty())
+			endTime = Math::Max(endTime, endTimes.back());
 
-		ret.AddUnique(*obj);
-		obj += 1; // Next
+		m_renderBuckets[bucket].Add(obj);
+		endTimes.Add(endTime);
 	}
+	MarkOverlappingChips();
+}
 
-	return ret;
+void BeatmapPlayback::m_QueryRenderBucket(uint32 bucketIndex, MapTime begin, MapTime end)
+{
+	const Vector<ObjectState*>& objects = m_renderBuckets[bucketIndex];
+	const Vector<MapTime>& endTimes = m_renderBucketEndTimes[bucketIndex];
+
+	// Nothing before this index ends after the start of the range
+	size_t first = std::lower_bound(endTimes.begin(), endTimes.end(), begin) - endTimes.begin();
+	for (size_t i = first; i < objects.size(); i++)
+	{
+		MultiObjectState* obj = *objects[i];
+		if (obj->time >= end)
+			break; // No more objects
+
+		if (GetObjectEndTime(obj) < begin)
+			continue;
+
+		if (!m_viewRange.Includes(obj->time))
+			continue;
+		if (obj->type != ObjectType::Single && !m_viewRange.Includes(GetObjectEndTime(obj), true))
+			continue;
+
+		m_objectsInRange.Add(objects[i]);
+	}
 }
 
 const TimingPoint& BeatmapPlayback::GetCurrentTimingPoint() const
@@ -411,46 +500,8 @@ uint32 BeatmapPlayback::CountBeats(MapTime start, MapTime range, int32& startInd
 }
 MapTime BeatmapPlayback::ViewDistanceToDuration(float distance)
 {
-	TimingPoint** tp = m_SelectTimingPoint(m_playbackTime, true);
-
-	double time = 0;
-
-	MapTime currentTime = m_playbackTime;
-	while (true)
-	{
-		if (!IsEndTiming(tp + 1))
-		{
-			double maxDist = (tp[1]->time - (double)currentTime) / tp[0]->beatDuration;
-			if (maxDist < distance)
-			{
-				// Split up
-				time += maxDist * tp[0]->beatDuration;
-				distance -= (float)maxDist;
-				tp++;
-				continue;
-			}
-		}
-		time += distance * tp[0]->beatDuration;
-		break;
-	}
-
-	/// TODO: Optimize?
-	uint32 processedStops = 0;
-	Vector<ChartStop*> ignoreStops;
-	do
-	{
-		processedStops = 0;
-		for (auto cs : m_SelectChartStops(currentTime, time))
-		{
-			if (std::find(ignoreStops.begin(), ignoreStops.end(), cs) != ignoreStops.end())
-				continue;
-			time += cs->duration;
-			processedStops++;
-			ignoreStops.Add(cs);
-		}
-	} while (processedStops);
-
-	return (MapTime)time;
+	double startDistance = m_GetViewDistance(m_viewDistances, m_playbackTime);
+	return m_GetViewDistanceTime(m_viewDistances, startDistance + distance) - m_playbackTime;
 }
 float BeatmapPlayback::DurationToViewDistance(MapTime duration)
 {
@@ -459,42 +510,7 @@ float BeatmapPlayback::DurationToViewDistance(MapTime duration)
 
 float BeatmapPlayback::DurationToViewDistanceAtTimeNoStops(MapTime time, MapTime duration)
 {
-	MapTime endTime = time + duration;
-	int8 direction = Math::Sign(duration);
-	if (duration < 0)
-	{
-		MapTime temp = time;
-		time = endTime;
-		endTime = temp;
-		duration *= -1;
-	}
-
-	// Accumulated value
-	double barTime = 0.0f;
-
-	// Split up to see if passing other timing points on the way
-	TimingPoint** tp = m_SelectTimingPoint(time, true);
-	while (true)
-	{
-		if (!IsEndTiming(tp + 1))
-		{
-			if (tp[1]->time < endTime)
-			{
-				// Split up
-				MapTime myDuration = tp[1]->time - time;
-				barTime += (double)myDuration / tp[0]->beatDuration;
-				duration -= myDuration;
-				time = tp[1]->time;
-				tp++;
-				continue;
-			}
-		}
-		// Whole
-		barTime += (double)duration / tp[0]->beatDuration;
-		break;
-	}
-
-	return (float)barTime * direction;
+	return (float)(m_GetViewDistance(m_viewDistancesNoStops, time + duration) - m_GetViewDistance(m_viewDistancesNoStops, time));
 }
 
 float BeatmapPlayback::DurationToViewDistanceAtTime(MapTime time, MapTime duration)
@@ -503,65 +519,110 @@ float BeatmapPlayback::DurationToViewDistanceAtTime(MapTime time, MapTime durati
 	{
 		return (float)duration / 480000.0f;
 	}
-	MapTime endTime = time + duration;
-	int8 direction = Math::Sign(duration);
-	if (duration < 0)
-	{
-		MapTime temp = time;
-		time = endTime;
-		endTime = temp;
-		duration *= -1;
-	}
 
-	MapTime startTime = time;
+	return (float)(m_GetViewDistance(m_viewDistances, time + duration) - m_GetViewDistance(m_viewDistances, time));
+}
 
-	// Accumulated value
-	double barTime = 0.0f;
+float BeatmapPlayback::TimeToViewDistance(MapTime time)
+{
+	if (cMod)
+		return (float)(time - m_playbackTime) / (480000.f);
 
-	// Split up to see if passing other timing points on the way
-	TimingPoint** tp = m_SelectTimingPoint(time, true);
-	while (true)
+	return DurationToViewDistanceAtTime(m_playbackTime, time - m_playbackTime);
+}
+
+void BeatmapPlayback::m_BuildViewDistanceTables()
+{
+	m_BuildViewDistanceTable(m_viewDistances, true);
+	m_BuildViewDistanceTable(m_viewDistancesNoStops, false);
+}
+
+void BeatmapPlayback::m_BuildViewDistanceTable(Vector<ViewDistancePoint>& table, bool includeStops)
+{
+	table.clear();
+	if (m_timingPoints.empty())
+		return;
+
+	// Every point where the view distance rate can change
+	Vector<MapTime> times;
+	for (TimingPoint* tp : m_timingPoints)
+		times.Add(tp->time);
+
+	// Start and end times of the stops, the stops open at a time are the starts minus the ends before it
+	Vector<MapTime> stopStarts;
+	Vector<MapTime> stopEnds;
+	if (includeStops)
 	{
-		if (!IsEndTiming(tp + 1))
+		for (ChartStop* cs : m_chartStops)
 		{
-			if (tp[1]->time < endTime)
-			{
-				// Split up
-				MapTime myDuration = tp[1]->time - time;
-				barTime += (double)myDuration / tp[0]->beatDuration;
-				duration -= myDuration;
-				time = tp[1]->time;
-				tp++;
-				continue;
-			}
+			stopStarts.Add(cs->time);
+			stopEnds.Add(cs->time + cs->duration);
 		}
-		// Whole
-		barTime += (double)duration / tp[0]->beatDuration;
-		break;
+		std::sort(stopStarts.begin(), stopStarts.end());
+		std::sort(stopEnds.begin(), stopEnds.end());
+		times.insert(times.end(), stopStarts.begin(), stopStarts.end());
+		times.insert(times.end(), stopEnds.begin(), stopEnds.end());
 	}
+	std::sort(times.begin(), times.end());
+	times.erase(std::unique(times.begin(), times.end()), times.end());
 
-	// calculate stop ViewDistance
-	double stopTime = 0.;
-	for (auto cs : m_SelectChartStops(startTime, endTime - startTime))
+	size_t tpIndex = 0;
+	size_t stopStartIndex = 0;
+	size_t stopEndIndex = 0;
+	for (MapTime time : times)
 	{
-		MapTime overlap = Math::Min(abs(endTime - startTime), 
-			Math::Min(abs(endTime - cs->time), 
-				Math::Min(abs((cs->time + cs->duration) - startTime), abs((cs->time + cs->duration) - cs->time))));
-
-		stopTime += DurationToViewDistanceAtTimeNoStops(Math::Max(cs->time, startTime), overlap);
+		while (tpIndex + 1 < m_timingPoints.size() && m_timingPoints[tpIndex + 1]->time <= time)
+			tpIndex++;
+		while (stopStartIndex < stopStarts.size() && stopStarts[stopStartIndex] <= time)
+			stopStartIndex++;
+		while (stopEndIndex < stopEnds.size() && stopEnds[stopEndIndex] <= time)
+			stopEndIndex++;
+		bool stopped = stopStartIndex > stopEndIndex;
+
+		ViewDistancePoint point;
+		point.time = time;
+		point.distance = 0.0;
+		point.rate = stopped ? 0.0 : 1.0 / m_timingPoints[tpIndex]->beatDuration;
+		if (!table.empty())
+		{
+			const ViewDistancePoint& prev = table.back();
+			point.distance = prev.distance + (time - prev.time) * prev.rate;
+		}
+		table.Add(point);
 	}
-	barTime -= stopTime;
+}
 
+double BeatmapPlayback::m_GetViewDistance(const Vector<ViewDistancePoint>& table, MapTime time) const
+{
+	assert(!table.empty());
+
+	// Times before the first point use the first timing point's rate
+	if (time < table.front().time)
+		return table.front().distance + (time - table.front().time) / m_timingPoints.front()->beatDuration;
 
-	return (float)barTime * direction;
+	// Last point at or before the given time
+	auto it = std::upper_bound(table.begin(), table.end(), time, [](MapTime t, const ViewDistancePoint& p)
+	{
+		return t < p.time;
+	}) - 1;
+	return it->distance + (time - it->time) * it->rate;
 }
 
-float BeatmapPlayback::TimeToViewDistance(MapTime time)
+MapTime BeatmapPlayback::m_GetViewDistanceTime(const Vector<ViewDistancePoint>& table, double distance) const
 {
-	if (cMod)
-		return (float)(time - m_playbackTime) / (480000.f);
+	assert(!table.empty());
 
-	return DurationToViewDistanceAtTime(m_playbackTime, time - m_playbackTime);
+	if (distance < table.front().distance)
+		return table.front().time + (MapTime)((distance - table.front().distance) * m_timingPoints.front()->beatDuration);
+
+	// Last point at or before the given distance, this skips over stops that end at this distance
+	auto it = std::upper_bound(table.begin(), table.end(), distance, [](double d, const ViewDistancePoint& p)
+	{
+		return d < p.distance;
+	}) - 1;
+	if (it->rate <= 0.0)
+		return it->time;
+	return it->time + (MapTime)((distance - it->distance) / it->rate);
 }
 
 float BeatmapPlayback::GetBarTime() const
@@ -623,19 +684,6 @@ TimingPoint** BeatmapPlayback::m_SelectTimingPoint(MapTime time, bool allowReset
 	return objStart;
 }
 
-Vector<ChartStop*> BeatmapPlayback::m_SelectChartStops(MapTime time, MapTime duration)
-{
-	Vector<ChartStop*> stops;
-	for (auto cs : m_chartStops)
-	{
-		if (time <= cs->time + cs->duration && time + duration >= cs->time)
-			stops.Add(cs);
-	}
-	return stops;
-}
-
-
-
 LaneHideTogglePoint** BeatmapPlayback::m_SelectLaneTogglePoint(MapTime time, bool allowReset)
 {
 	LaneHideTogglePoint** objStart = m_currentLaneTogglePoint;
@@ -5,7 +5,8 @@
 DBStatement::DBStatement(const String& statement, Database* db) : m_db(*db)
 {
 	m_queryResult = 0;
-	m_compileResult = sqlite3_prepare(m_db.db, *statement, (int)statement.size()+1, &m_stmt, nullptr);
+	// v2 recompiles automatically when the schema changes, needed for statements that are kept around
+	m_compileResult = sqlite3_prepare_v2(m_db.db, *statement, (int)statement.size()+1, &m_stmt, nullptr);
 	if(m_compileResult != SQLITE_OK)
 	{
 		Logf("Failed to compile statement:\n%s\n-> %s", Logger::Severity::Error, statement, sqlite3_errmsg(m_db.db));
@@ -141,6 +142,9 @@ Database::~Database()
 }
 void Database::Close()
 {
+	auto lock = Lock();
+	// All statements need to be finalized before the connection can close
+	m_statementCache.clear();
 	if(db)
 	{
 		sqlite3_close(db);
@@ -159,11 +163,27 @@ bool Database::Open(const String& path)
 }
 DBStatement Database::Query(const String& queryString)
 {
+	auto lock = Lock();
 	DBStatement statement(queryString, this);
 	return std::move(statement);
 }
+DBStatement& Database::CachedQuery(const String& queryString)
+{
+	auto lock = Lock();
+	auto it = m_statementCache.find(queryString);
+	if(it == m_statementCache.end())
+	{
+		it = m_statementCache.emplace(queryString, DBStatement(queryString, this)).first;
+	}
+	else
+	{
+		it->second.Rewind();
+	}
+	return it->second;
+}
 bool Database::Exec(const String& queryString)
 {
+	auto lock = Lock();
 	DBStatement stmt = Query(queryString);
 	if(!stmt)
 		return false;
@@ -172,6 +192,7 @@ bool Database::Exec(const String& queryString)
 
 bool Database::ExecDirect(const String& queryString)
 {
+	auto lock = Lock();
 	char* err;
 	if(sqlite3_exec(db, *queryString, nullptr, nullptr, &err) != SQLITE_OK)
 	{
@@ -180,3 +201,7 @@ bool Database::ExecDirect(const String& queryString)
 	}
 	return true;
 }
+std::unique_lock<std::recursive_mutex> Database::Lock()
+{
+	return std::unique_lock<std::recursive_mutex>(m_mutex);
+}
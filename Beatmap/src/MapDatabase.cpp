@@ -5,6 +5,7 @@
 #include "TinySHA1.hpp"
 #include "Shared/Profiling.hpp"
 #include "Shared/Files.hpp"
+#include "Shared/FileWatcher.hpp"
 #include "Shared/Time.hpp"
 #include "KShootMap.hpp"
 #include <thread>
@@ -42,9 +43,8 @@ public:
 	Map<String, FolderIndex*> m_foldersByPath;
 	Multimap<int32, PracticeSetupIndex*> m_practiceSetupsByChartId;
 
+	// Only used by the search thread, chart and challenge ids are the rowids the database assigns
 	int32 m_nextFolderId = 1;
-	int32 m_nextChartId = 1;
-	int32 m_nextChalId = 1;
 	String m_sortField = "title";
 	bool m_transferScores = true;
 
@@ -58,11 +58,14 @@ public:
 		// Maps file paths to the id's and last write time's for difficulties already in the database
 		Map<String, ExistingFileEntry> difficulties;
 		Map<String, ExistingFileEntry> challenges;
+		// Maps folder paths to the id's of folders in the database, kept up to date with the changes the search thread writes
+		Map<String, int32> folders;
 	} m_searchState;
 
 	// Represents an event produced from a scan
 	//	a difficulty can be removed/added/updated
 	//	a BeatmapSettings structure will be provided for added/updated events
+	//	events are written to the database by the search thread before they are queued, Update only applies them to the loaded index
 	struct Event
 	{
 		enum Type{
@@ -80,17 +83,37 @@ public:
 		String path;
 		// Current lwt of file
 		uint64 lwt;
-		// Id of the map
+		// Id of the map, assigned when added maps are written
 		int32 id;
+		// Folder of added maps
+		int32 folderId;
 		// Scanned map data, for added/updated maps
 		BeatmapSettings* mapData = nullptr;
+		// Existing scores for added maps
+		Vector<ScoreIndex*> scores;
 		nlohmann::json json;
 		String hash;
 	};
 	List<Event> m_pendingChanges;
 	mutex m_pendingChangesLock;
 
-	static const int32 m_version = 17;
+	static const int32 m_version = 18;
+	// Time in milliseconds a single Update call may spend applying changes, and the number of changes taken per step
+	// screens call Update every frame while changes are pending
+	static const int32 m_updateBudget = 4;
+	static const size_t m_updateBatchSize = 64;
+
+	// Watches the search paths after a full scan so later changes only rescan the folders they happened in
+	FileWatcher m_watcher;
+	std::atomic<bool> m_watching;
+	// Folders reported by the watcher that have not been rescanned yet
+	Set<String> m_changedFolders;
+	bool m_changesLost = false;
+	Timer m_changedFoldersTimer;
+	// Folders the search thread is limited to, empty for a full scan
+	Vector<String> m_scanFolders;
+	// Time in milliseconds without new changes before changed folders are rescanned, so copying a folder causes only one rescan
+	static const int32 m_watchDelay = 1000;
 
 public:
 	MapDatabase_Impl(MapDatabase& outer, bool transferScores) : m_outer(outer)
@@ -102,7 +125,11 @@ public:
 			Logf("Failed to open database [%s]", Logger::Severity::Warning, databasePath);
 			assert(false);
 		}
+		// Writers don't block readers with a write-ahead log, and it only needs syncing at checkpoints
+		m_database.ExecDirect("PRAGMA journal_mode=WAL");
+		m_database.ExecDirect("PRAGMA synchronous=NORMAL");
 		m_paused.store(false);
+		m_watching.store(false);
 		bool rebuild = false;
 		bool update = false;
 		DBStatement versionQuery = m_database.Query("SELECT version FROM `Database`");
@@ -136,7 +163,8 @@ public:
 		{
 			ProfilerScope $(Utility::Sprintf("Upgrading db (%d -> %d)", gotVersion, m_version));
 
-			//back up old db file
+			//back up old db file, with everything from the write-ahead log moved into it
+			m_database.ExecDirect("PRAGMA wal_checkpoint(TRUNCATE)");
 			Path::Copy(Path::Absolute("maps.db"), Path::Absolute("maps.db_" + Shared::Time::Now().ToString() + ".bak"));
 
 			m_outer.OnDatabaseUpdateStarted.Call(1);
@@ -367,6 +395,11 @@ public:
 					")");
 				gotVersion = 17;
 			}
+			if (gotVersion == 17)
+			{
+				m_CreateIndices();
+				gotVersion = 18;
+			}
 			m_database.Exec(Utility::Sprintf("UPDATE Database SET `version`=%d WHERE `rowid`=1", m_version));
 
 			m_outer.OnDatabaseUpdateDone.Call();
@@ -386,12 +419,14 @@ public:
 		StopSearching();
 		m_CleanupMapIndex();
 
-		//discard pending changes, probably should apply them(?)
+		// Discard pending changes, they are already in the database
 		auto changes = FlushChanges();
 		for (auto& c : changes)
 		{
 			if(c.mapData)
 				delete c.mapData;
+			for(auto s : c.scores)
+				delete s;
 		}
 	}
 
@@ -403,9 +438,49 @@ public:
 		if(m_thread.joinable())
 			m_thread.join();
 		// Apply previous diff to prevent duplicated entry 
-		Update();
+		Update(true);
 		// Create initial data set to compare to when evaluating if a file is added/removed/updated
 		m_LoadInitialData();
+		// A full scan covers everything the watcher reported so far
+		m_changedFolders.clear();
+		m_changesLost = false;
+		m_scanFolders.clear();
+		ResumeSearching();
+		m_interruptSearch = false;
+		m_searching = true;
+		m_thread = thread(&MapDatabase_Impl::m_SearchThread, this);
+	}
+	// Rescans the folders reported by the watcher once they stopped changing
+	void UpdateWatcher()
+	{
+		if(!m_watching.load())
+			return;
+
+		size_t numChanged = m_changedFolders.size();
+		bool lostChanges = m_watcher.PollChanges(m_changedFolders);
+		if(m_changedFolders.size() != numChanged || lostChanges)
+			m_changedFoldersTimer.Restart();
+		m_changesLost |= lostChanges;
+
+		if(m_changedFolders.empty() && !m_changesLost)
+			return;
+		if(m_searching || HasPendingChanges() || m_changedFoldersTimer.Milliseconds() < m_watchDelay)
+			return;
+
+		if(m_changesLost)
+		{
+			Log("Lost track of changes in the song folders, rescanning everything", Logger::Severity::Info);
+			StartSearching();
+			return;
+		}
+
+		if(m_thread.joinable())
+			m_thread.join();
+		Update(true);
+		// The loaded index is up to date with all applied changes, so it doesn't need to be reloaded from the database
+		m_RebuildSearchState();
+		m_scanFolders = m_CollapseChangedFolders();
+		m_changedFolders.clear();
 		ResumeSearching();
 		m_interruptSearch = false;
 		m_searching = true;
@@ -439,13 +514,6 @@ public:
 	}
 
 	/* Thread safe event queue functions */
-	// Add a new change to the change queue
-	void AddChange(Event change)
-	{
-		m_pendingChangesLock.lock();
-		m_pendingChanges.emplace_back(change);
-		m_pendingChangesLock.unlock();
-	}
 	// Removes changes from the queue and returns them
 	//	additionally you can specify the maximum amount of changes to remove from the queue
 	List<Event> FlushChanges(size_t maxChanges = -1)
@@ -460,17 +528,25 @@ public:
 		{
 			for(size_t i = 0; i < maxChanges && !m_pendingChanges.empty(); i++)
 			{
-				changes.AddFront(m_pendingChanges.front());
+				changes.AddBack(m_pendingChanges.front());
 				m_pendingChanges.pop_front();
 			}
 		}
 		m_pendingChangesLock.unlock();
 		return std::move(changes);
 	}
+	bool HasPendingChanges()
+	{
+		m_pendingChangesLock.lock();
+		bool pending = !m_pendingChanges.empty();
+		m_pendingChangesLock.unlock();
+		return pending;
+	}
 
 	// TODO(itszn) make sure this is not case sensitive
 	ChartIndex* FindFirstChartByPath(const String& searchString)
 	{
+		auto lock = m_database.Lock();
 		String stmt = "SELECT DISTINCT rowid FROM Charts WHERE path LIKE ? LIMIT 1";
 
 		DBStatement search = m_database.Query(stmt);
@@ -489,6 +565,7 @@ public:
 
 	ChartIndex* FindFirstChartByNameAndLevel(const String& name, uint32 level, bool exact=true)
 	{
+		auto lock = m_database.Lock();
 		String stmt = "SELECT DISTINCT rowid FROM Charts WHERE title LIKE ? and level=? LIMIT 1";
 
 		DBStatement search = m_database.Query(stmt);
@@ -523,6 +600,7 @@ public:
 
 	Map<int32, FolderIndex*> FindFoldersByHash(const String& hash)
 	{
+		auto lock = m_database.Lock();
 		String stmt = "SELECT DISTINCT folderId FROM Charts WHERE hash = ?";
 		DBStatement search = m_database.Query(stmt);
 		search.BindString(1, hash);
@@ -544,6 +622,7 @@ public:
 	// TODO(itszn) make this not case sensitive
 	Map<int32, FolderIndex*> FindFoldersByPath(const String& searchString)
 	{
+		auto lock = m_database.Lock();
 		String stmt = "SELECT DISTINCT folderId FROM Charts WHERE path LIKE ?";
 		DBStatement search = m_database.Query(stmt);
 		search.BindString(1, "%" + searchString + "%");
@@ -564,6 +643,7 @@ public:
 
 	Map<int32, ChallengeIndex*> FindChallenges(const String& searchString)
 	{
+		auto lock = m_database.Lock();
 		WString test = Utility::ConvertToWString(searchString);
 		String stmt = "SELECT DISTINCT rowid FROM Challenges WHERE";
 
@@ -607,6 +687,7 @@ public:
 	
 	Map<int32, FolderIndex*> FindFolders(const String& searchString)
 	{
+		auto lock = m_database.Lock();
 		WString test = Utility::ConvertToWString(searchString);
 		String stmt = "SELECT DISTINCT folderId FROM Charts WHERE";
 
@@ -654,6 +735,7 @@ public:
 
 	Vector<String> GetCollections()
 	{
+		auto lock = m_database.Lock();
 		Vector<String> res;
 		DBStatement search = m_database.Query("SELECT DISTINCT collection FROM collections");
 		while (search.StepRow())
@@ -665,6 +747,7 @@ public:
 
 	Vector<String> GetCollectionsForMap(int32 mapid)
 	{
+		auto lock = m_database.Lock();
 		Vector<String> res;
 		DBStatement search = m_database.Query(Utility::Sprintf("SELECT DISTINCT collection FROM collections WHERE folderid==%d", mapid));
 		while (search.StepRow())
@@ -719,6 +802,7 @@ public:
 
 	Map<int32, FolderIndex*> FindFoldersByCollection(const String& collection)
 	{
+		auto lock = m_database.Lock();
 		String stmt = "SELECT folderid FROM Collections WHERE collection==?";
 		DBStatement search = m_database.Query(stmt);
 		search.BindString(1, collection);
@@ -740,6 +824,7 @@ public:
 
 	Map<int32, FolderIndex*> FindFoldersByFolder(const String& folder)
 	{
+		auto lock = m_database.Lock();
 		char csep[2];
 		csep[0] = Path::sep;
 		csep[1] = 0;
@@ -762,30 +847,14 @@ public:
 
 		return res;
 	}
-	// Processes pending database changes
-	void Update()
+	// Applies pending changes to the loaded index, the search thread already wrote them to the database
+	//	unless applyAll is set this stops after m_updateBudget milliseconds, leaving the remaining changes for the next call
+	void Update(bool applyAll = false)
 	{
-		List<Event> changes = FlushChanges();
+		List<Event> changes = FlushChanges(applyAll ? -1 : m_updateBatchSize);
 		if(changes.empty())
 			return;
 
-		DBStatement addChart = m_database.Query("INSERT INTO Charts("
-			"folderId,path,title,artist,title_translit,artist_translit,jacket_path,effector,illustrator,"
-			"diff_name,diff_shortname,bpm,diff_index,level,hash,preview_file,preview_offset,preview_length,lwt) "
-			"VALUES(?,?,?,?,?,?,?,?,?,?,?,?,?,?,?,?,?,?,?)");
-		DBStatement addFolder = m_database.Query("INSERT INTO Folders(path,rowid) VALUES(?,?)");
-		DBStatement addChallenge = m_database.Query("INSERT INTO Challenges("
-			"title,charts,chart_meta,clear_mark,best_score,req_text,path,hash,level,lwt) "
-			"VALUES(?,?,?,?,?,?,?,?,?,?)");
-		DBStatement update = m_database.Query("UPDATE Charts SET path=?,title=?,artist=?,title_translit=?,artist_translit=?,jacket_path=?,effector=?,illustrator=?,"
-			"diff_name=?,diff_shortname=?,bpm=?,diff_index=?,level=?,hash=?,preview_file=?,preview_offset=?,preview_length=?,lwt=? WHERE rowid=?"); //TODO: update
-		DBStatement updateChallenge = m_database.Query("UPDATE Challenges SET title=?,charts=?,chart_meta=?,clear_mark=?,best_score=?,req_text=?,path=?,hash=?,level=?,lwt=? WHERE rowid=?");
-		DBStatement removeChart = m_database.Query("DELETE FROM Charts WHERE rowid=?");
-		DBStatement removeChallenge = m_database.Query("DELETE FROM Challenges WHERE rowid=?");
-		DBStatement removeFolder = m_database.Query("DELETE FROM Folders WHERE rowid=?");
-		DBStatement scoreScan = m_database.Query("SELECT rowid,score,crit,near,miss,gauge,gameflags,replay,timestamp,user_name,user_id,local_score,window_perfect,window_good,window_hold,window_miss FROM Scores WHERE chart_hash=?");
-		DBStatement moveScores = m_database.Query("UPDATE Scores set chart_hash=? where chart_hash=?");
-
 		Set<FolderIndex*> addedChartEvents;
 		Set<FolderIndex*> removeChartEvents;
 		Set<FolderIndex*> updatedChartEvents;
@@ -797,16 +866,22 @@ public:
 		const String diffShortNames[4] = { "NOV", "ADV", "EXH", "INF" };
 		const String diffNames[4] = { "Novice", "Advanced", "Exhaust", "Infinite" };
 
-		m_database.Exec("BEGIN");
-		for(Event& e : changes)
+		// Applies a single change, the resulting events are collected in the sets above
+		auto ApplyChange = [&](Event& e)
 		{
 			if (e.type == Event::Challenge && (e.action == Event::Added || e.action == Event::Updated))
 			{
+				if (e.json.is_discarded() || e.json.is_null())
+				{
+					Log("Tried to process invalid json in Challenge Add event", Logger::Severity::Warning);
+					return;
+				}
+
 				ChallengeIndex* chal;
 				if (e.action == Event::Added)
 				{
 					chal = new ChallengeIndex();
-					chal->id = m_nextChalId++;
+					chal->id = e.id;
 				}
 				else
 				{
@@ -815,11 +890,6 @@ public:
 					chal = itChal->second;
 				}
 
-				if (e.json.is_discarded() || e.json.is_null())
-				{
-					Log("Tried to process invalid json in Challenge Add event", Logger::Severity::Warning);
-					continue;
-				}
 				chal->settings = e.json;
 				chal->settings["title"].get_to(chal->title);
 				chal->path = e.path;
@@ -834,52 +904,17 @@ public:
 				chal->lwt = e.lwt;
 				chal->charts.clear();
 
-				String chartMeta = "";
 				// Grab the charts
 				chal->FindCharts(&m_outer, chal->settings["charts"]);
 				chal->GenerateDescription();
 
-				String chartString = chal->settings["charts"].dump();
-
 				if (e.action == Event::Added)
 				{
 					m_challenges.Add(chal->id, chal);
-
-					// Add Chart
-					// ("title,charts,chart_meta,clear_mark,best_score,req_text,path,hash,level,lwt) "
-					addChallenge.BindString(1, chal->title);
-					addChallenge.BindString(2, chartString);
-					addChallenge.BindString(3, chartMeta);
-					addChallenge.BindInt(4, chal->clearMark);
-					addChallenge.BindInt(5, chal->bestScore);
-					addChallenge.BindString(6, chal->reqText);
-					addChallenge.BindString(7, chal->path);
-					addChallenge.BindString(8, chal->hash);
-					addChallenge.BindInt(9, chal->level);
-					addChallenge.BindInt64(10, chal->lwt);
-
-					addChallenge.Step();
-					addChallenge.Rewind();
-
 					addedChalEvents.Add(chal);
 				}
-				else if (e.action == Event::Updated)
+				else
 				{
-					updateChallenge.BindString(1, chal->title);
-					updateChallenge.BindString(2, chartString);
-					updateChallenge.BindString(3, chartMeta);
-					updateChallenge.BindInt(4, chal->clearMark);
-					updateChallenge.BindInt(5, chal->bestScore);
-					updateChallenge.BindString(6, chal->reqText);
-					updateChallenge.BindString(7, chal->path);
-					updateChallenge.BindString(8, chal->hash);
-					updateChallenge.BindInt(9, chal->level);
-					updateChallenge.BindInt64(10, chal->lwt);
-					updateChallenge.BindInt(11, e.id);
-
-					updateChallenge.Step();
-					updateChallenge.Rewind();
-
 					updatedChalEvents.Add(chal);
 				}
 			}
@@ -890,36 +925,25 @@ public:
 
 				delete itChal->second;
 				m_challenges.erase(e.id);
-
-				// Remove diff in db
-				removeChallenge.BindInt(1, e.id);
-				removeChallenge.Step();
-				removeChallenge.Rewind();
 			}
 			if(e.type == Event::Chart && e.action == Event::Added)
 			{
-				String folderPath = Path::RemoveLast(e.path, nullptr);
 				bool existingUpdated;
 				FolderIndex* folder;
 
 				// Add or get folder
-				auto folderIt = m_foldersByPath.find(folderPath);
-				if(folderIt == m_foldersByPath.end())
+				auto folderIt = m_folders.find(e.folderId);
+				if(folderIt == m_folders.end())
 				{
 					// Add folder
 					folder = new FolderIndex();
-					folder->id = m_nextFolderId++;
-					folder->path = folderPath;
+					folder->id = e.folderId;
+					folder->path = Path::RemoveLast(e.path, nullptr);
 					folder->selectId = (int32) m_folders.size();
 
 					m_folders.Add(folder->id, folder);
 					m_foldersByPath.Add(folder->path, folder);
 
-					addFolder.BindString(1, folder->path);
-					addFolder.BindInt(2, folder->id);
-					addFolder.Step();
-					addFolder.Rewind();
-
 					existingUpdated = false; // New folder
 				}
 				else
@@ -930,7 +954,7 @@ public:
 
 
 				ChartIndex* chart = new ChartIndex();
-				chart->id = m_nextChartId++;
+				chart->id = e.id;
 				chart->lwt = e.lwt;
 				chart->folderId = folder->id;
 				chart->path = e.path;
@@ -949,36 +973,17 @@ public:
 				chart->jacket_path = e.mapData->jacketPath;
 				chart->hash = e.hash;
 
-				// Check for existing scores for this chart
-				scoreScan.BindString(1, chart->hash);
-				while (scoreScan.StepRow())
+				// Existing scores for this chart were read with the change
+				for (auto score : e.scores)
 				{
-					ScoreIndex* score = new ScoreIndex();
-					score->id = scoreScan.IntColumn(0);
-					score->score = scoreScan.IntColumn(1);
-					score->crit = scoreScan.IntColumn(2);
-					score->almost = scoreScan.IntColumn(3);
-					score->miss = scoreScan.IntColumn(4);
-					score->gauge = (float) scoreScan.DoubleColumn(5);
-					score->gameflags = scoreScan.IntColumn(6);
-					score->replayPath = scoreScan.StringColumn(7);
-
-					score->timestamp = scoreScan.Int64Column(8);
-					score->userName = scoreScan.StringColumn(9);
-					score->userId = scoreScan.StringColumn(10);
-					score->localScore = scoreScan.IntColumn(11);
-
-					score->hitWindowPerfect = scoreScan.IntColumn(12);
-					score->hitWindowGood = scoreScan.IntColumn(13);
-					score->hitWindowHold = scoreScan.IntColumn(14);
-					score->hitWindowMiss = scoreScan.IntColumn(15);
-
 					score->chartHash = chart->hash;
 					chart->scores.Add(score);
 				}
-				scoreScan.Rewind();
+				e.scores.clear();
 
 				m_SortScores(chart);
+				chart->scoresLoaded = true;
+				chart->m_database = this;
 
 				m_charts.Add(chart->id, chart);
 				m_chartsByHash.Add(chart->hash, chart);
@@ -986,30 +991,6 @@ public:
 				folder->charts.Add(chart);
 				m_SortCharts(folder);
 
-				// Add Chart
-				addChart.BindInt(1, chart->folderId);
-				addChart.BindString(2, chart->path);
-				addChart.BindString(3, chart->title);
-				addChart.BindString(4, chart->artist);
-				addChart.BindString(5, chart->title_translit);
-				addChart.BindString(6, chart->artist_translit);
-				addChart.BindString(7, chart->jacket_path);
-				addChart.BindString(8, chart->effector);
-				addChart.BindString(9, chart->illustrator);
-				addChart.BindString(10, chart->diff_name);
-				addChart.BindString(11, chart->diff_shortname);
-				addChart.BindString(12, chart->bpm);
-				addChart.BindInt(13, chart->diff_index);
-				addChart.BindInt(14, chart->level);
-				addChart.BindString(15, chart->hash);
-				addChart.BindString(16, chart->preview_file);
-				addChart.BindInt(17, chart->preview_offset);
-				addChart.BindInt(18, chart->preview_length);
-				addChart.BindInt64(19, chart->lwt);
-
-				addChart.Step();
-				addChart.Rewind();
-
 				// Send appropriate notification
 				if(existingUpdated)
 				{
@@ -1022,29 +1003,6 @@ public:
 			}
 			else if(e.type == Event::Chart && e.action == Event::Updated)
 			{
-				update.BindString(1, e.path);
-				update.BindString(2, e.mapData->title);
-				update.BindString(3, e.mapData->artist);
-				update.BindString(4, "");
-				update.BindString(5, "");
-				update.BindString(6, e.mapData->jacketPath);
-				update.BindString(7, e.mapData->effector);
-				update.BindString(8, e.mapData->illustrator);
-				update.BindString(9, diffNames[e.mapData->difficulty]);
-				update.BindString(10, diffShortNames[e.mapData->difficulty]);
-				update.BindString(11, e.mapData->bpm);
-				update.BindInt(12, e.mapData->difficulty);
-				update.BindInt(13, e.mapData->level);
-				update.BindString(14, e.hash);
-				update.BindString(15, e.mapData->audioNoFX);
-				update.BindInt(16, e.mapData->previewOffset);
-				update.BindInt(17, e.mapData->previewDuration);
-				update.BindInt64(18, e.lwt);
-				update.BindInt(19, e.id);
-
-				update.Step();
-				update.Rewind();
-
 				auto itChart = m_charts.find(e.id);
 				assert(itChart != m_charts.end());
 
@@ -1064,15 +1022,6 @@ public:
 				chart->bpm = e.mapData->bpm;
 				chart->illustrator = e.mapData->illustrator;
 				chart->jacket_path = e.mapData->jacketPath;
-
-
-				// Check if the hash has changed...
-				if (chart->hash != e.hash && m_transferScores) {
-					moveScores.BindString(1, e.hash);
-					moveScores.BindString(2, chart->hash);
-					moveScores.Step();
-					moveScores.Rewind();
-				}
 				chart->hash = e.hash;
 
 
@@ -1100,19 +1049,10 @@ public:
 				delete itChart->second;
 				m_charts.erase(e.id);
 
-				// Remove diff in db
-				removeChart.BindInt(1, e.id);
-				removeChart.Step();
-				removeChart.Rewind();
-
 				if(itFolder->second->charts.empty()) // Remove map as well
 				{
 					removeChartEvents.Add(itFolder->second);
 
-					removeFolder.BindInt(1, itFolder->first);
-					removeFolder.Step();
-					removeFolder.Rewind();
-
 					m_foldersByPath.erase(itFolder->second->path);
 					m_folders.erase(itFolder);
 				}
@@ -1123,8 +1063,40 @@ public:
 			}
 			if(e.mapData)
 				delete e.mapData;
+			for(auto s : e.scores)
+				delete s;
+		};
+
+		Timer budgetTimer;
+		while(!changes.empty())
+		{
+			for(Event& e : changes)
+				ApplyChange(e);
+
+			// Events are delivered once per call, so stopping here also bounds the work the UI does with them
+			if(budgetTimer.Milliseconds() >= m_updateBudget)
+				break;
+			changes = FlushChanges(m_updateBatchSize);
+		}
+
+		// Requirement texts name the charts of a challenge, so they can only be stored once the charts are loaded
+		if(!addedChalEvents.empty() || !updatedChalEvents.empty())
+		{
+			auto lock = m_database.Lock();
+			DBStatement& updateReqText = m_database.CachedQuery("UPDATE Challenges SET req_text=? WHERE rowid=?");
+			m_database.Exec("BEGIN");
+			for(auto& events : { &addedChalEvents, &updatedChalEvents })
+			{
+				for(ChallengeIndex* chal : *events)
+				{
+					updateReqText.BindString(1, chal->reqText);
+					updateReqText.BindInt(2, chal->id);
+					updateReqText.Step();
+					updateReqText.Rewind();
+				}
+			}
+			m_database.Exec("END");
 		}
-		m_database.Exec("END");
 
 		// Fire events
 		if(!removeChartEvents.empty())
@@ -1190,9 +1162,35 @@ public:
 		}
 	}
 
+	// Replaces the scores kept at startup with all scores of the chart
+	void LoadScores(ChartIndex* chart)
+	{
+		auto lock = m_database.Lock();
+		ProfilerScope $("Chart Database - Load Scores");
+		for (auto s : chart->scores)
+		{
+			delete s;
+		}
+		chart->scores.clear();
+
+		DBStatement& scoreScan = m_database.CachedQuery("SELECT rowid,score,crit,near,miss,gauge,gameflags,replay,timestamp,user_name,user_id,local_score,window_perfect,window_good,window_hold,window_miss FROM Scores WHERE chart_hash=?");
+		scoreScan.BindString(1, chart->hash);
+		while (scoreScan.StepRow())
+		{
+			ScoreIndex* score = m_ReadScore(scoreScan);
+			score->chartHash = chart->hash;
+			chart->scores.Add(score);
+		}
+		scoreScan.Rewind();
+
+		m_SortScores(chart);
+		chart->scoresLoaded = true;
+	}
+
 	void AddScore(ScoreIndex* score)
 	{
-		DBStatement addScore = m_database.Query("INSERT INTO Scores(score,crit,near,miss,gauge,gameflags,replay,timestamp,chart_hash,user_name,user_id,local_score,window_perfect,window_good,window_hold,window_miss) VALUES(?,?,?,?,?,?,?,?,?,?,?,?,?,?,?,?)");
+		auto lock = m_database.Lock();
+		DBStatement& addScore = m_database.CachedQuery("INSERT INTO Scores(score,crit,near,miss,gauge,gameflags,replay,timestamp,chart_hash,user_name,user_id,local_score,window_perfect,window_good,window_hold,window_miss) VALUES(?,?,?,?,?,?,?,?,?,?,?,?,?,?,?,?)");
 
 		m_database.Exec("BEGIN");
 		addScore.BindInt(1, score->score);
@@ -1220,6 +1218,7 @@ public:
 
 	void UpdateChallengeResult(ChallengeIndex* chal, uint32 clearMark, uint32 bestScore)
 	{
+		auto lock = m_database.Lock();
 		assert(chal != nullptr);
 		assert(m_challenges.Contains(chal->id));
 
@@ -1249,6 +1248,7 @@ public:
 
 	void UpdateOrAddPracticeSetup(PracticeSetupIndex* practiceSetup)
 	{
+		auto lock = m_database.Lock();
 		if (!m_charts.Contains(practiceSetup->chartId))
 		{
 			Logf("UpdateOrAddPracticeSetup called for invalid chart %d", Logger::Severity::Warning, practiceSetup->chartId);
@@ -1331,12 +1331,14 @@ public:
 
 	void UpdateChartOffset(const ChartIndex* chart)
 	{
+		auto lock = m_database.Lock();
 		// Safe from sqli bc hash will be alphanum
 		m_database.Exec(Utility::Sprintf("UPDATE Charts SET custom_offset=%d WHERE hash LIKE '%s'", chart->custom_offset, *chart->hash));
 	}
 
 	void AddOrRemoveToCollection(const String& name, int32 mapid)
 	{
+		auto lock = m_database.Lock();
 		DBStatement addColl = m_database.Query("INSERT INTO Collections(folderid,collection) VALUES(?,?)");
 		m_database.Exec("BEGIN");
 
@@ -1502,14 +1504,25 @@ private:
 			"level INTEGER,"
 			"lwt INTEGER"
 			")");
+
+		m_CreateIndices();
+	}
+	// Indices for the columns used to look up rows
+	void m_CreateIndices()
+	{
+		m_database.Exec("CREATE INDEX IF NOT EXISTS idx_scores_chart_hash ON Scores(chart_hash)");
+		m_database.Exec("CREATE INDEX IF NOT EXISTS idx_charts_hash ON Charts(hash)");
+		m_database.Exec("CREATE INDEX IF NOT EXISTS idx_charts_folderid ON Charts(folderid)");
+		m_database.Exec("CREATE INDEX IF NOT EXISTS idx_charts_path ON Charts(path)");
+		m_database.Exec("CREATE INDEX IF NOT EXISTS idx_collections_folderid ON Collections(folderid)");
+		m_database.Exec("CREATE INDEX IF NOT EXISTS idx_practicesetups_chart_id ON PracticeSetups(chart_id)");
 	}
 	void m_LoadInitialData()
 	{
+		auto lock = m_database.Lock();
+		ProfilerScope $("Chart Database - Load Initial Data");
 		assert(!m_searching);
 
-		// Clear search state
-		m_searchState.difficulties.clear();
-
 		// Scan original maps
 		m_CleanupMapIndex();
 
@@ -1578,62 +1591,85 @@ private:
 			m_charts.Add(chart->id, chart);
 			m_chartsByHash.Add(chart->hash, chart);
 
-			// Add difficulty to map and resort difficulties
+			// Add difficulty to map, folders are sorted once all charts are loaded
 			auto folderIt = m_folders.find(chart->folderId);
 			assert(folderIt != m_folders.end());
 			folderIt->second->charts.Add(chart);
-			m_SortCharts(folderIt->second);
-
-			// Add to search state
-			SearchState::ExistingFileEntry ed;
-			ed.id = chart->id;
-			if (chart->hash.length() == 0)
-			{
-				ed.lwt = 0;
-			}
-			else {
-				ed.lwt = chart->lwt;
-
-			}
-			m_searchState.difficulties.Add(chart->path, ed);
 		}
+		for (auto& folder : m_folders)
+			m_SortCharts(folder.second);
 
 		// Select Scores
-		DBStatement scoreScan = m_database.Query("SELECT rowid,score,crit,near,miss,gauge,gameflags,replay,timestamp,chart_hash,user_name,user_id,local_score,window_perfect,window_good,window_hold,window_miss FROM Scores");
-		
+		// Only the scores that decide a chart's best score and clear mark are kept, ChartIndex::GetAllScores loads the rest.
+		// A clear mark can only get better with a higher score, fewer misses or a higher gauge with the same game flags,
+		// so the best score of each of these covers the best clear mark of the chart
+		struct ScoreSummary
+		{
+			ScoreIndex* bestScore = nullptr;
+			ScoreIndex* fewestMisses = nullptr;
+			Map<uint32, ScoreIndex*> bestGauge;
+			size_t numScores = 0;
+		};
+		Map<ChartIndex*, ScoreSummary> summaries;
+		Vector<ScoreIndex*> readScores;
+		DBStatement scoreScan = m_database.Query("SELECT rowid,score,crit,near,miss,gauge,gameflags,replay,timestamp,user_name,user_id,local_score,window_perfect,window_good,window_hold,window_miss,chart_hash FROM Scores");
 		while (scoreScan.StepRow())
 		{
-			ScoreIndex* score = new ScoreIndex();
-			score->id = scoreScan.IntColumn(0);
-			score->score = scoreScan.IntColumn(1);
-			score->crit = scoreScan.IntColumn(2);
-			score->almost = scoreScan.IntColumn(3);
-			score->miss = scoreScan.IntColumn(4);
-			score->gauge = (float) scoreScan.DoubleColumn(5);
-			score->gameflags = scoreScan.IntColumn(6);
-			score->replayPath = scoreScan.StringColumn(7);
-
-			score->timestamp = scoreScan.Int64Column(8);
-			score->chartHash = scoreScan.StringColumn(9);
-			score->userName = scoreScan.StringColumn(10);
-			score->userId = scoreScan.StringColumn(11);
-			score->localScore = scoreScan.IntColumn(12);
-
-			score->hitWindowPerfect = scoreScan.IntColumn(13);
-			score->hitWindowGood = scoreScan.IntColumn(14);
-			score->hitWindowHold = scoreScan.IntColumn(15);
-			score->hitWindowMiss = scoreScan.IntColumn(16);
-
-			// Add difficulty to map and resort difficulties
-			auto diffIt = m_chartsByHash.find(score->chartHash);
+			auto diffIt = m_chartsByHash.find(scoreScan.StringColumn(16));
 			if (diffIt == m_chartsByHash.end()) // If for whatever reason the diff that the score is attatched to is not in the db, ignore the score.
-			{
-				delete score;
 				continue;
-			}
 
-			diffIt->second->scores.Add(score);
-			m_SortScores(diffIt->second);
+			ScoreSummary& summary = summaries[diffIt->second];
+			summary.numScores++;
+			int32 scoreValue = scoreScan.IntColumn(1);
+			int32 miss = scoreScan.IntColumn(4);
+			float gauge = (float)scoreScan.DoubleColumn(5);
+			ScoreIndex*& bestGauge = summary.bestGauge[(uint32)scoreScan.IntColumn(6)];
+			bool isBestScore = !summary.bestScore || scoreValue > summary.bestScore->score;
+			bool isFewestMisses = !summary.fewestMisses || miss < summary.fewestMisses->miss;
+			bool isBestGauge = !bestGauge || gauge > bestGauge->gauge;
+			if (!isBestScore && !isFewestMisses && !isBestGauge)
+				continue;
+
+			// The string columns are only read for scores that are kept
+			ScoreIndex* score = m_ReadScore(scoreScan);
+			score->chartHash = diffIt->second->hash;
+			readScores.Add(score);
+			if (isBestScore)
+				summary.bestScore = score;
+			if (isFewestMisses)
+				summary.fewestMisses = score;
+			if (isBestGauge)
+				bestGauge = score;
+		}
+		Set<ScoreIndex*> keptScores;
+		for (auto& it : summaries)
+		{
+			ChartIndex* chart = it.first;
+			ScoreSummary& summary = it.second;
+			Set<ScoreIndex*> chartScores;
+			chartScores.Add(summary.bestScore);
+			chartScores.Add(summary.fewestMisses);
+			for (auto& gauge : summary.bestGauge)
+				chartScores.Add(gauge.second);
+			for (ScoreIndex* score : chartScores)
+			{
+				chart->scores.Add(score);
+				keptScores.Add(score);
+			}
+			m_SortScores(chart);
+			chart->scoresLoaded = chartScores.size() == summary.numScores;
+		}
+		for (ScoreIndex* score : readScores)
+		{
+			if (!keptScores.Contains(score))
+				delete score;
+		}
+		for (auto& chart : m_charts)
+		{
+			chart.second->m_database = this;
+			if (!summaries.Contains(chart.second))
+				chart.second->scoresLoaded = true;
 		}
 
 		// Select Practice setups
@@ -1717,23 +1753,74 @@ private:
 				chal->lwt = 0;
 
 			m_challenges.Add(chal->id, chal);
+		}
 
-			// Add to search state
+		m_outer.OnChallengesCleared.Call(m_challenges);
+
+		m_RebuildSearchState();
+	}
+	// Fills the search state from the loaded charts and challenges
+	void m_RebuildSearchState()
+	{
+		m_searchState.difficulties.clear();
+		m_searchState.challenges.clear();
+		m_searchState.folders.clear();
+		for(auto& it : m_folders)
+			m_searchState.folders.Add(it.second->path, it.first);
+		for(auto& it : m_charts)
+		{
+			ChartIndex* chart = it.second;
+			SearchState::ExistingFileEntry ed;
+			ed.id = chart->id;
+			// Charts without a hash are always rescanned
+			ed.lwt = chart->hash.length() == 0 ? 0 : chart->lwt;
+			m_searchState.difficulties.Add(chart->path, ed);
+		}
+		for(auto& it : m_challenges)
+		{
+			ChallengeIndex* chal = it.second;
 			SearchState::ExistingFileEntry ed;
 			ed.id = chal->id;
-			if (chal->hash.length() == 0)
+			ed.lwt = chal->hash.length() == 0 ? 0 : chal->lwt;
+			m_searchState.challenges.Add(chal->path, ed);
+		}
+	}
+	// Reduces the changed folders to the ones that are not inside another changed folder
+	Vector<String> m_CollapseChangedFolders()
+	{
+		Vector<String> folders;
+		for(const String& folder : m_changedFolders)
+		{
+			bool covered = false;
+			for(const String& other : m_changedFolders)
 			{
-				ed.lwt = 0;
-			}
-			else {
-				ed.lwt = chal->lwt;
-
+				if(m_IsInFolder(folder, other))
+				{
+					covered = true;
+					break;
+				}
 			}
-			m_searchState.challenges.Add(chal->path, ed);
+			if(!covered)
+				folders.Add(folder);
 		}
-		m_nextChalId = m_challenges.empty() ? 1 : (m_challenges.rbegin()->first + 1);
-
-		m_outer.OnChallengesCleared.Call(m_challenges);
+		return folders;
+	}
+	static bool m_IsInFolder(const String& path, const String& folder)
+	{
+		return path.length() > folder.length() && path[folder.length()] == Path::sep &&
+			path.compare(0, folder.length(), folder) == 0;
+	}
+	// Checks if a file is inside the folders of the current scan
+	bool m_IsScanned(const String& path)
+	{
+		if(m_scanFolders.empty())
+			return true;
+		for(const String& folder : m_scanFolders)
+		{
+			if(m_IsInFolder(path, folder))
+				return true;
+		}
+		return false;
 	}
 	void m_SortCharts(FolderIndex* folderIndex)
 	{
@@ -1745,6 +1832,32 @@ private:
 		});
 	}
 
+	// Reads a score from a row starting with the columns
+	// rowid,score,crit,near,miss,gauge,gameflags,replay,timestamp,user_name,user_id,local_score,window_perfect,window_good,window_hold,window_miss
+	static ScoreIndex* m_ReadScore(DBStatement& scoreScan)
+	{
+		ScoreIndex* score = new ScoreIndex();
+		score->id = scoreScan.IntColumn(0);
+		score->score = scoreScan.IntColumn(1);
+		score->crit = scoreScan.IntColumn(2);
+		score->almost = scoreScan.IntColumn(3);
+		score->miss = scoreScan.IntColumn(4);
+		score->gauge = (float) scoreScan.DoubleColumn(5);
+		score->gameflags = scoreScan.IntColumn(6);
+		score->replayPath = scoreScan.StringColumn(7);
+
+		score->timestamp = scoreScan.Int64Column(8);
+		score->userName = scoreScan.StringColumn(9);
+		score->userId = scoreScan.StringColumn(10);
+		score->localScore = scoreScan.IntColumn(11);
+
+		score->hitWindowPerfect = scoreScan.IntColumn(12);
+		score->hitWindowGood = scoreScan.IntColumn(13);
+		score->hitWindowHold = scoreScan.IntColumn(14);
+		score->hitWindowMiss = scoreScan.IntColumn(15);
+		return score;
+	}
+
 	void m_SortScores(ChartIndex* diffIndex)
 	{
 		diffIndex->scores.Sort([](ScoreIndex* a, ScoreIndex* b)
@@ -1753,24 +1866,264 @@ private:
 		});
 	}
 
+	// Writes scanned changes to the database in one transaction and queues them for Update
+	//	called from the search thread, the database is only locked while the batch is written
+	void m_CommitChanges(List<Event>& changes)
+	{
+		if(changes.empty())
+			return;
+
+		{
+			auto lock = m_database.Lock();
+
+			DBStatement& addChart = m_database.CachedQuery("INSERT INTO Charts("
+				"folderId,path,title,artist,title_translit,artist_translit,jacket_path,effector,illustrator,"
+				"diff_name,diff_shortname,bpm,diff_index,level,hash,preview_file,preview_offset,preview_length,lwt) "
+				"VALUES(?,?,?,?,?,?,?,?,?,?,?,?,?,?,?,?,?,?,?)");
+			DBStatement& addFolder = m_database.CachedQuery("INSERT INTO Folders(path,rowid) VALUES(?,?)");
+			DBStatement& addChallenge = m_database.CachedQuery("INSERT INTO Challenges("
+				"title,charts,chart_meta,clear_mark,best_score,req_text,path,hash,level,lwt) "
+				"VALUES(?,?,?,?,?,?,?,?,?,?)");
+			DBStatement& update = m_database.CachedQuery("UPDATE Charts SET path=?,title=?,artist=?,title_translit=?,artist_translit=?,jacket_path=?,effector=?,illustrator=?,"
+				"diff_name=?,diff_shortname=?,bpm=?,diff_index=?,level=?,hash=?,preview_file=?,preview_offset=?,preview_length=?,lwt=? WHERE rowid=?");
+			// Clear marks and best scores are written by UpdateChallengeResult, requirement texts by Update
+			DBStatement& updateChallenge = m_database.CachedQuery("UPDATE Challenges SET title=?,charts=?,chart_meta=?,path=?,hash=?,level=?,lwt=? WHERE rowid=?");
+			DBStatement& removeChart = m_database.CachedQuery("DELETE FROM Charts WHERE rowid=?");
+			DBStatement& removeChallenge = m_database.CachedQuery("DELETE FROM Challenges WHERE rowid=?");
+			DBStatement& removeFolder = m_database.CachedQuery("DELETE FROM Folders WHERE rowid=?");
+			DBStatement& folderCharts = m_database.CachedQuery("SELECT rowid FROM Charts WHERE folderId=? LIMIT 1");
+			DBStatement& insertedId = m_database.CachedQuery("SELECT last_insert_rowid()");
+			DBStatement& scoreScan = m_database.CachedQuery("SELECT rowid,score,crit,near,miss,gauge,gameflags,replay,timestamp,user_name,user_id,local_score,window_perfect,window_good,window_hold,window_miss FROM Scores WHERE chart_hash=?");
+			DBStatement& moveScores = m_database.CachedQuery("UPDATE Scores SET chart_hash=? WHERE chart_hash=(SELECT hash FROM Charts WHERE rowid=?)");
+
+			const String diffShortNames[4] = { "NOV", "ADV", "EXH", "INF" };
+			const String diffNames[4] = { "Novice", "Advanced", "Exhaust", "Infinite" };
+
+			auto GetInsertedId = [&]()
+			{
+				int32 id = insertedId.StepRow() ? insertedId.IntColumn(0) : 0;
+				insertedId.Rewind();
+				return id;
+			};
+
+			m_database.Exec("BEGIN");
+			for(Event& e : changes)
+			{
+				if(e.type == Event::Challenge && (e.action == Event::Added || e.action == Event::Updated))
+				{
+					// Update skips these as well
+					if(e.json.is_discarded() || e.json.is_null())
+						continue;
+
+					String title;
+					int32 level;
+					e.json["title"].get_to(title);
+					e.json["level"].get_to(level);
+					String chartString = e.json["charts"].dump();
+					String chartMeta = "";
+
+					if(e.action == Event::Added)
+					{
+						// ("title,charts,chart_meta,clear_mark,best_score,req_text,path,hash,level,lwt) "
+						addChallenge.BindString(1, title);
+						addChallenge.BindString(2, chartString);
+						addChallenge.BindString(3, chartMeta);
+						addChallenge.BindInt(4, 0);
+						addChallenge.BindInt(5, 0);
+						addChallenge.BindString(6, "");
+						addChallenge.BindString(7, e.path);
+						addChallenge.BindString(8, e.hash);
+						addChallenge.BindInt(9, level);
+						addChallenge.BindInt64(10, e.lwt);
+
+						addChallenge.Step();
+						addChallenge.Rewind();
+						e.id = GetInsertedId();
+					}
+					else
+					{
+						updateChallenge.BindString(1, title);
+						updateChallenge.BindString(2, chartString);
+						updateChallenge.BindString(3, chartMeta);
+						updateChallenge.BindString(4, e.path);
+						updateChallenge.BindString(5, e.hash);
+						updateChallenge.BindInt(6, level);
+						updateChallenge.BindInt64(7, e.lwt);
+						updateChallenge.BindInt(8, e.id);
+
+						updateChallenge.Step();
+						updateChallenge.Rewind();
+					}
+				}
+				else if(e.type == Event::Challenge && e.action == Event::Removed)
+				{
+					removeChallenge.BindInt(1, e.id);
+					removeChallenge.Step();
+					removeChallenge.Rewind();
+				}
+				else if(e.type == Event::Chart && e.action == Event::Added)
+				{
+					// Add or get folder
+					String folderPath = Path::RemoveLast(e.path, nullptr);
+					int32* folderId = m_searchState.folders.Find(folderPath);
+					if(folderId)
+					{
+						e.folderId = *folderId;
+					}
+					else
+					{
+						e.folderId = m_nextFolderId++;
+						m_searchState.folders.Add(folderPath, e.folderId);
+
+						addFolder.BindString(1, folderPath);
+						addFolder.BindInt(2, e.folderId);
+						addFolder.Step();
+						addFolder.Rewind();
+					}
+
+					addChart.BindInt(1, e.folderId);
+					addChart.BindString(2, e.path);
+					addChart.BindString(3, e.mapData->title);
+					addChart.BindString(4, e.mapData->artist);
+					addChart.BindString(5, "");
+					addChart.BindString(6, "");
+					addChart.BindString(7, e.mapData->jacketPath);
+					addChart.BindString(8, e.mapData->effector);
+					addChart.BindString(9, e.mapData->illustrator);
+					addChart.BindString(10, diffNames[e.mapData->difficulty]);
+					addChart.BindString(11, diffShortNames[e.mapData->difficulty]);
+					addChart.BindString(12, e.mapData->bpm);
+					addChart.BindInt(13, e.mapData->difficulty);
+					addChart.BindInt(14, e.mapData->level);
+					addChart.BindString(15, e.hash);
+					addChart.BindString(16, e.mapData->audioNoFX);
+					addChart.BindInt(17, e.mapData->previewOffset);
+					addChart.BindInt(18, e.mapData->previewDuration);
+					addChart.BindInt64(19, e.lwt);
+
+					addChart.Step();
+					addChart.Rewind();
+					e.id = GetInsertedId();
+
+					// Check for existing scores for this chart
+					scoreScan.BindString(1, e.hash);
+					while(scoreScan.StepRow())
+					{
+						e.scores.Add(m_ReadScore(scoreScan));
+					}
+					scoreScan.Rewind();
+				}
+				else if(e.type == Event::Chart && e.action == Event::Updated)
+				{
+					// Scores follow the chart if its hash changed, this has to happen before the new hash is written
+					if(m_transferScores)
+					{
+						moveScores.BindString(1, e.hash);
+						moveScores.BindInt(2, e.id);
+						moveScores.Step();
+						moveScores.Rewind();
+					}
+
+					update.BindString(1, e.path);
+					update.BindString(2, e.mapData->title);
+					update.BindString(3, e.mapData->artist);
+					update.BindString(4, "");
+					update.BindString(5, "");
+					update.BindString(6, e.mapData->jacketPath);
+					update.BindString(7, e.mapData->effector);
+					update.BindString(8, e.mapData->illustrator);
+					update.BindString(9, diffNames[e.mapData->difficulty]);
+					update.BindString(10, diffShortNames[e.mapData->difficulty]);
+					update.BindString(11, e.mapData->bpm);
+					update.BindInt(12, e.mapData->difficulty);
+					update.BindInt(13, e.mapData->level);
+					update.BindString(14, e.hash);
+					update.BindString(15, e.mapData->audioNoFX);
+					update.BindInt(16, e.mapData->previewOffset);
+					update.BindInt(17, e.mapData->previewDuration);
+					update.BindInt64(18, e.lwt);
+					update.BindInt(19, e.id);
+
+					update.Step();
+					update.Rewind();
+				}
+				else if(e.type == Event::Chart && e.action == Event::Removed)
+				{
+					removeChart.BindInt(1, e.id);
+					removeChart.Step();
+					removeChart.Rewind();
+
+					// Remove the folder with its last chart
+					String folderPath = Path::RemoveLast(e.path, nullptr);
+					int32* folderId = m_searchState.folders.Find(folderPath);
+					if(folderId)
+					{
+						folderCharts.BindInt(1, *folderId);
+						bool empty = !folderCharts.StepRow();
+						folderCharts.Rewind();
+						if(empty)
+						{
+							removeFolder.BindInt(1, *folderId);
+							removeFolder.Step();
+							removeFolder.Rewind();
+							m_searchState.folders.erase(folderPath);
+						}
+					}
+				}
+			}
+			m_database.Exec("END");
+		}
+
+		m_pendingChangesLock.lock();
+		m_pendingChanges.splice(m_pendingChanges.end(), changes);
+		m_pendingChangesLock.unlock();
+	}
+	// Queues a scanned change, changes are written in batches of m_updateBatchSize
+	void m_AddScannedChange(List<Event>& changes, const Event& change)
+	{
+		changes.AddBack(change);
+		if(changes.size() >= m_updateBatchSize)
+			m_CommitChanges(changes);
+	}
+
 	// Main search thread
 	void m_SearchThread()
 	{
 		Map<String, FileInfo> fileList;
 		Map<String, FileInfo> challengeFileList;
 		Map<String, FileInfo> legacyChallengeFileList;
+		// Changes that are not written yet
+		List<Event> changes;
+
+		// Either only the folders reported by the watcher or everything
+		// A full scan watches the folders it enumerates, changed folders are already being watched
+		bool fullScan = m_scanFolders.empty();
+		Vector<String> scanRoots = m_scanFolders;
+		if(fullScan)
+		{
+			m_watcher.Clear();
+			for(const String& rootSearchPath : m_searchPaths)
+				scanRoots.Add(rootSearchPath);
+		}
+
 		{
 			ProfilerScope $("Chart Database - Enumerate Files and Charts");
 			m_outer.OnSearchStatusUpdated.Call("[START] Chart Database - Enumerate Files and Folders");
-			for(String rootSearchPath : m_searchPaths)
+			for(String rootSearchPath : scanRoots)
 			{
+				// Changed folders may have been removed, their charts are removed below
+				if(!m_scanFolders.empty() && !Path::IsDirectory(rootSearchPath))
+					continue;
 				Vector<String> exts(3);
 				exts[0] = "ksh";
 				exts[1] = "chal";
 				exts[2] = "kco";
-				Map<String, Vector<FileInfo>> files = Files::ScanFilesRecursive(rootSearchPath, exts, &m_interruptSearch);
+				Vector<String> folders;
+				Map<String, Vector<FileInfo>> files = Files::ScanFilesRecursive(rootSearchPath, exts, &m_interruptSearch, fullScan ? &folders : nullptr);
 				if(m_interruptSearch)
 					return;
+				// A folder that changes between being listed and being watched is only picked up by the next full scan
+				m_watcher.AddFolders(folders);
 				for(FileInfo& fi : files["ksh"])
 				{
 					fileList.Add(fi.fullPath, fi);
@@ -1784,6 +2137,8 @@ private:
 					legacyChallengeFileList.Add(fi.fullPath, fi);
 				}
 			}
+			if(fullScan)
+				m_watching.store(true);
 			m_outer.OnSearchStatusUpdated.Call("[END] Chart Database - Enumerate Files and Folders");
 		}
 
@@ -1793,14 +2148,14 @@ private:
 			// Process scanned files
 			for(auto f : m_searchState.difficulties)
 			{
-				if(!fileList.Contains(f.first))
+				if(!fileList.Contains(f.first) && m_IsScanned(f.first))
 				{
 					Event evt;
 					evt.type = Event::Chart;
 					evt.action = Event::Removed;
 					evt.path = f.first;
 					evt.id = f.second.id;
-					AddChange(evt);
+					m_AddScannedChange(changes, evt);
 				}
 			}
 			m_outer.OnSearchStatusUpdated.Call("[END] Chart Database - Process Removed Charts");
@@ -1904,7 +2259,7 @@ private:
 					evt.action = Event::Removed;
 				}
 				evt.path = f.first;
-				AddChange(evt);
+				m_AddScannedChange(changes, evt);
 				continue;
 			}
 			m_outer.OnSearchStatusUpdated.Call("[END] Chart Database - Process New Charts");
@@ -1917,14 +2272,14 @@ private:
 			// Process scanned files
 			for(auto f : m_searchState.challenges)
 			{
-				if(!challengeFileList.Contains(f.first))
+				if(!challengeFileList.Contains(f.first) && m_IsScanned(f.first))
 				{
 					Event evt;
 					evt.type = Event::Challenge;
 					evt.action = Event::Removed;
 					evt.path = f.first;
 					evt.id = f.second.id;
-					AddChange(evt);
+					m_AddScannedChange(changes, evt);
 				}
 			}
 			m_outer.OnSearchStatusUpdated.Call("[END] Chart Database - Process Removed Challenges");
@@ -1997,12 +2352,15 @@ private:
 			// If we added a json file we have to rescan for chals, this only happens when converting legacy courses
 			if (addedNewJson)
 			{
-				for (String rootSearchPath : m_searchPaths)
+				challengeFileList.clear();
+				for (String rootSearchPath : scanRoots)
 				{
-					challengeFileList.clear();
 					Vector<FileInfo> files = Files::ScanFilesRecursive(rootSearchPath, "chal", &m_interruptSearch);
 					if (m_interruptSearch)
+					{
+						m_CommitChanges(changes);
 						return;
+					}
 					for (FileInfo& fi : files)
 					{
 						challengeFileList.Add(fi.fullPath, fi);
@@ -2110,13 +2468,14 @@ private:
 					evt.json = settings;
 				}
 				evt.path = f.first;
-				AddChange(evt);
+				m_AddScannedChange(changes, evt);
 				continue;
 			}
 			m_outer.OnSearchStatusUpdated.Call("[END] Chart Database - Process New Challenges");
 		}
 		m_outer.OnSearchStatusUpdated.Call("");
 
+		m_CommitChanges(changes);
 		m_searching = false;
 	}
 
@@ -2145,6 +2504,11 @@ MapDatabase::~MapDatabase()
 void MapDatabase::Update()
 {
 	m_impl->Update();
+	m_impl->UpdateWatcher();
+}
+bool MapDatabase::HasPendingChanges()
+{
+	return m_impl->HasPendingChanges();
 }
 bool MapDatabase::IsSearching() const
 {
@@ -2236,6 +2600,12 @@ void MapDatabase::UpdateChallengeResult(ChallengeIndex* chal, uint32 clearMark,
 {
 	m_impl->UpdateChallengeResult(chal, clearMark, bestScore);
 }
+Vector<ScoreIndex*>& ChartIndex::GetAllScores()
+{
+	if (!scoresLoaded && m_database)
+		m_database->LoadScores(this);
+	return scores;
+}
 ChartIndex* MapDatabase::GetRandomChart()
 {
 	return m_impl->GetRandomChart();
@@ -7,9 +7,8 @@
 #include "Graphics/RenderQueue.hpp"
 #include "Shared/Transform.hpp"
 #include "Shared/Files.hpp"
-#include "Shared/Thread.hpp"
+#include "Shared/Jobs.hpp"
 #include <atomic>
-#include <mutex>
 
 struct Label
 {
@@ -24,23 +23,25 @@ struct Label
 
 struct ImageAnimation
 {
-	int FrameCount;
-	std::atomic<int32_t> CurrentFrame;
+	int FrameCount = 0;
+	int CurrentFrame = 0;
 	int TimesToLoop;
 	int LoopCounter;
-	int w;
-	int h;
 	float SecondsPerFrame;
 	float Timer;
-	std::atomic<bool> Compressed;
-	std::atomic<bool> LoadComplete;
+	// Resident animations upload every frame once and draw the current one
+	// others stream decoded frames into the animation image
+	bool Resident = false;
+	size_t ResidentBytes = 0;
+	bool LoadComplete = false;
 	std::atomic<bool> Cancelled;
-	std::mutex LoadMutex;
-	Vector<Graphics::Image> Frames;
-	Vector<Buffer> FrameData; //for storing the file contents of the compressed frames
-	Image CurrentImage; //the current uncompressed frame in use
-	Image NextImage;
-	Thread* JobThread;
+	Vector<FileInfo> Files;
+	Vector<Buffer> FrameData; //for storing the file contents of the frames
+	Vector<int> FrameImages; //nanovg images of the frames of resident animations
+	int FramesReady = 0;
+	Image NextImage; //decoded frame waiting to be streamed in
+	int NextFrame = -1;
+	bool DecodePending = false;
 	lua_State* State;
 };
 
@@ -67,6 +68,9 @@ struct GUIState
 	Rect scissor;
 	Vector2i resolution;
 	Map<int, Ref<ImageAnimation>> animations;
+	// Limit on the memory taken by frames of resident animations
+	size_t animationMemoryBudget = 0;
+	size_t animationMemoryUsed = 0;
 	int scissorOffset;
 	Vector<Transform> transformStack;
 	Vector<int> nvgFonts;
@@ -128,65 +132,130 @@ static int lBeginPath(lua_State* L)
 }
 
 
-static void AnimationLoader(Vector<FileInfo> files, Ref<ImageAnimation> ia)
+// Decodes a single animation frame on the job sheduler
+class AnimationDecodeJob : public JobBase
 {
-	ia->FrameCount = files.size();
-	files.Sort([](FileInfo& a, FileInfo& b) {
-		String af, bf;
-		Path::RemoveLast(a.fullPath, &af);
-		Path::RemoveLast(b.fullPath, &bf);
-		return af.compare(bf) < 0;
-	});
-	ia->Timer = 0;
-
-	if (ia->Compressed.load())
+public:
+	AnimationDecodeJob(Ref<ImageAnimation> ia, int frame) : m_ia(ia), m_frame(frame)
+	{
+	}
+	bool Run() override
 	{
-		for (int i = 0; i < ia->FrameCount; i++)
+		Buffer& data = m_ia->FrameData[m_frame];
+		if (m_ia->Cancelled.load() || data.size() < 4)
+			return false;
+		m_image = ImageRes::Create(data);
+		return m_image.get() != nullptr;
+	}
+	void Finalize() override
+	{
+		ImageAnimation& ia = *m_ia;
+		if (ia.Cancelled.load())
+			return;
+
+		if (ia.Resident)
 		{
-			if (ia->Cancelled.load())
-				break;
-			File newImage;
-			if (newImage.OpenRead(files[i].fullPath)) {
-				Buffer newData;
-				newData.resize(newImage.GetSize());
-				newImage.Read(newData.data(), newImage.GetSize());
-				ia->FrameData.push_back(std::move(newData));
+			if (m_image)
+			{
+				Vector2i size = m_image->GetSize();
+				ia.FrameImages[m_frame] = nvgCreateImageRGBA(g_guiState.vg, size.x, size.y, 0, (unsigned char*)m_image->GetBits());
+			}
+			if (++ia.FramesReady == ia.FrameCount)
+			{
+				// All frames live on the GPU now
+				ia.FrameData.clear();
+				ia.LoadComplete = true;
 			}
 		}
-		ia->NextImage = ImageRes::Create(ia->FrameData[0]);
-	}
-	else {
-		for (int i = 0; i < ia->FrameCount; i++)
+		else
 		{
-			if (ia->Cancelled.load())
-				break;
-			ia->Frames.Add(Graphics::ImageRes::Create(files[i].fullPath));
+			ia.NextImage = m_image;
+			ia.NextFrame = m_frame;
+			ia.DecodePending = false;
 		}
 	}
-	ia->LoadComplete.store(true);
 
+private:
+	Ref<ImageAnimation> m_ia;
+	int m_frame;
+	Image m_image;
+};
 
-	if (ia->Compressed.load())
+// Reads the frame files of an animation
+class AnimationLoadJob : public JobBase
+{
+public:
+	AnimationLoadJob(Ref<ImageAnimation> ia) : m_ia(ia)
+	{
+		jobFlags = JobFlags::IO;
+	}
+	bool Run() override
 	{
-		std::chrono::microseconds sleepDuration((uint32)(250000.f * ia->SecondsPerFrame));
-		int currentFrame = -1;
-		while (!ia->Cancelled.load())
+		ImageAnimation& ia = *m_ia;
+		ia.Files.Sort([](FileInfo& a, FileInfo& b) {
+			String af, bf;
+			Path::RemoveLast(a.fullPath, &af);
+			Path::RemoveLast(b.fullPath, &bf);
+			return af.compare(bf) < 0;
+		});
+
+		for (int i = 0; i < ia.FrameCount; i++)
 		{
-			if (ia->CurrentFrame != currentFrame)
-			{
-				currentFrame = ia->CurrentFrame;
-				int nextFrame = (currentFrame + 1) % ia->FrameCount;
-				Image nextImage = ImageRes::Create(ia->FrameData[nextFrame]);
-				ia->LoadMutex.lock();
-				ia->NextImage = nextImage;
-				ia->LoadMutex.unlock();
-			}
-			else 
-			{
-				std::this_thread::sleep_for(sleepDuration);
+			if (ia.Cancelled.load())
+				return false;
+			Buffer& newData = ia.FrameData.Add();
+			File newImage;
+			if (newImage.OpenRead(ia.Files[i].fullPath)) {
+				newData.resize(newImage.GetSize());
+				newImage.Read(newData.data(), newImage.GetSize());
 			}
 		}
+		return true;
 	}
+	void Finalize() override
+	{
+		ImageAnimation& ia = *m_ia;
+		if (ia.Cancelled.load() || !IsSuccessfull())
+			return;
+
+		if (ia.Resident)
+		{
+			ia.FrameImages.resize(ia.FrameCount, 0);
+			for (int i = 0; i < ia.FrameCount; i++)
+				g_jobSheduler->Queue(Job(new AnimationDecodeJob(m_ia, i)));
+		}
+		else
+		{
+			ia.LoadComplete = true;
+		}
+	}
+
+private:
+	Ref<ImageAnimation> m_ia;
+};
+
+// Makes sure the frame after the current one is being decoded for streamed animations
+static void QueueNextAnimationFrame(Ref<ImageAnimation> ia)
+{
+	if (ia->Resident || ia->DecodePending)
+		return;
+	int nextFrame = (ia->CurrentFrame + 1) % ia->FrameCount;
+	if (ia->NextFrame == nextFrame)
+		return;
+	ia->DecodePending = true;
+	g_jobSheduler->Queue(Job(new AnimationDecodeJob(ia, nextFrame)));
+}
+
+// Maps resident animations to the image of their current frame
+static int ResolveImage(int image)
+{
+	auto it = g_guiState.animations.find(image);
+	if (it == g_guiState.animations.end())
+		return image;
+	const ImageAnimation& ia = *it->second;
+	if (!ia.Resident || !ia.LoadComplete || ia.FrameImages[ia.CurrentFrame] == 0)
+		return image;
+	return ia.FrameImages[ia.CurrentFrame];
 }
 
 static int lTickAnimation(lua_State* L)
@@ -200,12 +269,14 @@ static int lTickAnimation(lua_State* L)
 		return 0;
 
 	Ref<ImageAnimation> ia = g_guiState.animations.at(key);
-	if (!ia->LoadComplete.load())
+	if (!ia->LoadComplete)
 		return 0;
 
 	if (ia->Cancelled.load())
 		return 0;
 
+	QueueNextAnimationFrame(ia);
+
 	ia->Timer += deltatime;
 	if (ia->Timer >= ia->SecondsPerFrame)
 	{
@@ -220,16 +291,12 @@ static int lTickAnimation(lua_State* L)
 				return 0;
 
 			ia->CurrentFrame = (ia->CurrentFrame + 1) % ia->FrameCount;
-			if (ia->Compressed.load())
+			if (!ia->Resident)
 			{
-				ia->LoadMutex.lock();
-				ia->CurrentImage = ia->NextImage;
-				ia->LoadMutex.unlock();
-				nvgUpdateImage(g_guiState.vg, key, (unsigned char*)ia->CurrentImage->GetBits());
-			}
-			else 
-			{
-				nvgUpdateImage(g_guiState.vg, key, (unsigned char*)ia->Frames[ia->CurrentFrame]->GetBits());
+				// Frames that haven't been decoded in time are skipped
+				if (ia->NextFrame == ia->CurrentFrame && ia->NextImage)
+					nvgUpdateImage(g_guiState.vg, key, (unsigned char*)ia->NextImage->GetBits());
+				QueueNextAnimationFrame(ia);
 			}
 		}
 	}
@@ -244,14 +311,27 @@ static int LoadAnimation(lua_State* L, const char* path, float frametime, int lo
 
 	int key = nvgCreateImage(g_guiState.vg, *files[0].fullPath, 0);
 	Ref<ImageAnimation> ia = std::make_shared<ImageAnimation>();
-	ia->Compressed = compressed;
+	ia->FrameCount = (int)files.size();
+	ia->Files = std::move(files);
 	ia->TimesToLoop = loopcount;
 	ia->LoopCounter = 0;
 	ia->SecondsPerFrame = frametime;
-	ia->LoadComplete.store(false);
+	ia->Timer = 0;
 	ia->Cancelled.store(false);
 	ia->State = L;
-	ia->JobThread = new Thread(AnimationLoader, files, ia);
+
+	// Keep all frames on the GPU if they fit in the budget, compressed animations always stream their frames
+	int w = 0, h = 0;
+	nvgImageSize(g_guiState.vg, key, &w, &h);
+	size_t frameBytes = (size_t)w * h * 4 * ia->FrameCount;
+	if (!compressed && g_guiState.animationMemoryUsed + frameBytes <= g_guiState.animationMemoryBudget)
+	{
+		ia->Resident = true;
+		ia->ResidentBytes = frameBytes;
+		g_guiState.animationMemoryUsed += frameBytes;
+	}
+
+	g_jobSheduler->Queue(Job(new AnimationLoadJob(ia)));
 	g_guiState.animations.insert(std::make_pair(key, ia));
 
 	return key;
@@ -408,6 +488,7 @@ static int lImagePatternFill(lua_State* L /*int image, float alpha*/)
 	int image = luaL_checkinteger(L, 1);
 	float alpha = luaL_checknumber(L, 2);
 	int w, h;
+	image = ResolveImage(image);
 	nvgImageSize(g_guiState.vg, image, &w, &h);
 	nvgFillPaint(g_guiState.vg, nvgImagePattern(g_guiState.vg, 0, 0, w, h, 0, image, alpha));
 	return 0;
@@ -436,7 +517,7 @@ static int lImageRect(lua_State* L /*float x, float y, float w, float h, int ima
 	y = luaL_checknumber(L, 2);
 	w = luaL_checknumber(L, 3);
 	h = luaL_checknumber(L, 4);
-	image = luaL_checkinteger(L, 5);
+	image = ResolveImage(luaL_checkinteger(L, 5));
 	alpha = luaL_checknumber(L, 6);
 	angle = luaL_checknumber(L, 7);
 
@@ -910,14 +991,18 @@ static int lGradientColors(lua_State* L /*int ri, int gi, int bi, int ai, int ro
 static int lFillPaint(lua_State* L /* int paint */)
 {
 	int paint = luaL_checkinteger(L, 1);
-	nvgFillPaint(g_guiState.vg, g_guiState.paintCache[L][paint]);
+	NVGpaint p = g_guiState.paintCache[L][paint];
+	p.image = ResolveImage(p.image);
+	nvgFillPaint(g_guiState.vg, p);
 	return 0;
 }
 
 static int lStrokePaint(lua_State* L /* int paint */)
 {
 	int paint = luaL_checkinteger(L, 1);
-	nvgStrokePaint(g_guiState.vg, g_guiState.paintCache[L][paint]);
+	NVGpaint p = g_guiState.paintCache[L][paint];
+	p.image = ResolveImage(p.image);
+	nvgStrokePaint(g_guiState.vg, p);
 	return 0;
 }
 
@@ -1050,14 +1135,17 @@ static int DisposeGUI(lua_State* state)
 		if (anim.second->State != state)
 			continue;
 
+		// Pending jobs keep their own reference and skip their work once cancelled
 		anim.second->Cancelled.store(true);
 
-		if(anim.second->JobThread && anim.second->JobThread->joinable())
-			anim.second->JobThread->join();
-		anim.second->Frames.clear();
-		anim.second->FrameData.clear();
+		for (int frameImage : anim.second->FrameImages)
+		{
+			if (frameImage != 0)
+				nvgDeleteImage(g_guiState.vg, frameImage);
+		}
+		anim.second->FrameImages.clear();
+		g_guiState.animationMemoryUsed -= anim.second->ResidentBytes;
 		keysToDelete.Add(anim.first);
-		delete anim.second->JobThread;
 		nvgDeleteImage(g_guiState.vg, anim.first);
 	}
 	for (int k : keysToDelete)
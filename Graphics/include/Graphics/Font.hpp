@@ -13,8 +13,14 @@ namespace Graphics
 	class TextRes
 	{
 		friend class Font_Impl;
-		struct FontSize* fontSize;
+		friend class TextCache;
 		Ref<class MeshRes> mesh;
+		// Atlas page the glyphs of this text were placed on
+		Ref<class TextureRes> texture;
+		uint32 page = 0;
+		uint32 pageGeneration = 0;
+		// Count of live text on the same page generation, the page is not cleared while text outside the font cache uses it
+		Ref<uint32> pageTexts;
 	public:
 		~TextRes();
 		Ref<class TextureRes> GetTexture();
@@ -11,9 +11,10 @@ namespace Graphics
 	{
 	public:
 		virtual ~ImageRes() = default;
-		static Ref<ImageRes> Create(const String& assetPath);
+		// minSize allows decoding large images at a reduced size that is still at least this big
+		static Ref<ImageRes> Create(const String& assetPath, Vector2i minSize = Vector2i());
 		static Ref<ImageRes> Create(Vector2i size = Vector2i());
-		static Ref<ImageRes> Create(Buffer& b);
+		static Ref<ImageRes> Create(Buffer& b, Vector2i minSize = Vector2i());
 		static Ref<ImageRes> Screenshot(class OpenGL* gl, Vector2i size = Vector2i(), Vector2i pos = Vector2i());
 	public:
 		virtual void SetSize(Vector2i size) = 0;
@@ -21,7 +22,8 @@ namespace Graphics
 		virtual Vector2i GetSize() const = 0;
 		virtual Colori* GetBits() = 0;
 		virtual const Colori* GetBits() const = 0;
-		virtual void SavePNG(const String& file) = 0;
+		// compressionLevel is the zlib level (0-9), negative uses the libpng default
+		virtual void SavePNG(const String& file, int32 compressionLevel = -1) = 0;
 	};
 
 	/*
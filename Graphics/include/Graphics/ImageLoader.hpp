@@ -12,7 +12,8 @@ namespace Graphics
 	class ImageLoader
 	{
 	public:
-		static bool Load(ImageRes* outPtr, const String& fullPath);
-		static bool Load(ImageRes* outPtr, Buffer& b);
+		// minSize allows formats that support it to decode at a reduced size, as long as both dimensions stay at least this large
+		static bool Load(ImageRes* outPtr, const String& fullPath, Vector2i minSize = Vector2i());
+		static bool Load(ImageRes* outPtr, Buffer& b, Vector2i minSize = Vector2i());
 	};
 }
\ No newline at end of file
@@ -8,7 +8,9 @@ namespace Graphics
 	/* A single parameter that is set for a material */
 	struct MaterialParameter
 	{
-		CopyableBuffer parameterData;
+		// Stored inline, large enough for the biggest parameter type (Transform)
+		uint8 parameterData[64];
+		uint32 parameterSize = 0;
 		uint32 parameterType;
 
 		template<typename T>
@@ -22,23 +24,24 @@ namespace Graphics
 		template<typename T>
 		void Bind(const T& obj)
 		{
-			parameterData.resize(sizeof(T));
-			memcpy(parameterData.data(), &obj, sizeof(T));
+			static_assert(sizeof(T) <= sizeof(parameterData), "Material parameter type too large");
+			parameterSize = sizeof(T);
+			memcpy(parameterData, &obj, sizeof(T));
 		}
 		template<typename T>
-		const T& Get()
+		const T& Get() const
 		{
-			assert(sizeof(T) == parameterData.size());
-			return *(T*)parameterData.data();
+			assert(sizeof(T) == parameterSize);
+			return *(const T*)parameterData;
 		}
 
 		bool operator==(const MaterialParameter& other) const
 		{
 			if(parameterType != other.parameterType)
 				return false;
-			if(parameterData.size() != other.parameterData.size())
+			if(parameterSize != other.parameterSize)
 				return false;
-			return memcmp(parameterData.data(), other.parameterData.data(), parameterData.size()) == 0;
+			return memcmp(parameterData, other.parameterData, parameterSize) == 0;
 		}
 	};
 
@@ -10,6 +10,19 @@ namespace Graphics
 	void GLDebugProc(GLenum source, GLenum type, GLuint id, GLenum severity, GLsizei length, const GLchar* message, const void* userParam);
 #endif
 
+	// Counters for the work submitted through render queues during a single frame
+	struct RenderStats
+	{
+		uint32 drawCalls = 0;
+		uint32 materialChanges = 0;
+		uint32 meshChanges = 0;
+		uint32 blendChanges = 0;
+		// Glyphs uploaded into font atlas pages
+		uint32 glyphUploads = 0;
+		// Image data streamed through the texture uploader
+		uint32 textureUploadBytes = 0;
+	};
+
 	/*
 		OpenGL context wrapper with common functionality
 	*/
@@ -20,12 +33,18 @@ namespace Graphics
 		uint32 m_mainProgramPipeline;
 		class OpenGL_Impl* m_impl;
 		Window* m_window;
+		RenderStats m_renderStats;
+		RenderStats m_lastFrameRenderStats;
+		uint32 m_frameIndex = 0;
 
 		friend class ShaderRes;
 		friend class TextureRes;
 		friend class MeshRes;
 		friend class Shader_Impl;
 		friend class RenderQueue;
+		friend struct FontSize;
+		friend class TextureUploader;
+		friend class ParticleSystem_Impl;
 
 	public:
 		OpenGL();
@@ -41,6 +60,11 @@ namespace Graphics
 		// Check if the calling thread is the thread that runs this OpenGL context
 		bool IsOpenGLThread() const;
 
+		// Render queue statistics of the last presented frame
+		const RenderStats& GetLastFrameRenderStats() const;
+		// Number of frames presented so far
+		uint32 GetFrameIndex() const;
+
 		virtual void SwapBuffers();
 	};
 }
\ No newline at end of file
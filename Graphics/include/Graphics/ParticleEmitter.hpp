@@ -56,8 +56,12 @@ namespace Graphics
 	private:
 		// Constructed by particle system
 		ParticleEmitter(class ParticleSystem_Impl* sys);
-		void Render(const class RenderState& rs, float deltaTime);
+		// Advances the simulation, spawning and removing particles
+		void Simulate(float deltaTime);
+		// Appends the vertices of all live particles
+		void GenerateVertices(Vector<struct ParticleVertex>& out) const;
 		void m_ReallocatePool(uint32 newCapacity);
+		void m_Integrate(uint32 begin, uint32 end, float deltaTime);
 
 		float m_spawnCounter = 0;
 		float m_emitterTime = 0;
@@ -65,13 +69,14 @@ namespace Graphics
 		bool m_deactivated = false;
 		bool m_finished = false;
 		uint32 m_emitterLoopIndex = 0;
-		Mesh m_mesh;
 		friend class ParticleSystem_Impl;
-		friend class Particle;
 		ParticleSystem_Impl* m_system;
 
-		class Particle* m_particles = nullptr;
+		// Particle pool, stored as structure of arrays
+		// live particles are kept packed in the range [0, m_numParticles)
+		struct ParticlePool* m_pool = nullptr;
 		uint32 m_poolSize = 0;
+		uint32 m_numParticles = 0;
 
 		// Particle parameters private
 #define PARTICLE_PARAMETER(__name, __type)\
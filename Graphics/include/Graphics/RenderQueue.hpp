@@ -8,17 +8,9 @@ namespace Graphics
 {
 
 	using Shared::Rect;
-	/*
-		Represents a draw command that can be executed in a render queue
-	*/
-	class RenderQueueItem
-	{
-	public:
-		virtual ~RenderQueueItem() = default;
-	};
 
 	// Most basic draw command that only contains a material, it's parameters and a world transform
-	class SimpleDrawCall : public RenderQueueItem
+	class SimpleDrawCall
 	{
 	public:
 		SimpleDrawCall();
@@ -34,7 +26,7 @@ namespace Graphics
 	};
 
 	// Command for points/lines with size/width parameter
-	class PointDrawCall : public RenderQueueItem
+	class PointDrawCall
 	{
 	public:
 		// List of points/lines
@@ -44,6 +36,16 @@ namespace Graphics
 		float size;
 	};
 
+	enum class RenderQueueSortMode
+	{
+		// Commands are executed in the order they were submitted
+		Submission,
+		// Commands are sorted by layer, blend mode, material, texture and mesh
+		//	a new layer is started for every command whose result depends on the draw order,
+		//	so only runs of additive draws are actually reordered
+		SortKey,
+	};
+
 	/*
 		This class is a queue that collects draw commands
 		each of these is stored together with their wanted render state.
@@ -54,7 +56,7 @@ namespace Graphics
 	{
 	public:
 		RenderQueue() = default;
-		RenderQueue(OpenGL* ogl, const RenderState& rs);
+		RenderQueue(OpenGL* ogl, const RenderState& rs, RenderQueueSortMode sortMode = RenderQueueSortMode::Submission);
 		RenderQueue(RenderQueue&& other);
 		RenderQueue& operator=(RenderQueue&& other);
 		~RenderQueue();
@@ -71,8 +73,26 @@ namespace Graphics
 		void DrawPoints(Mesh m, Material mat, const MaterialParameterSet& params, float pointSize);
 
 	private:
+		// Reference to a draw call stored in one of the command arenas
+		struct Command
+		{
+			uint64 sortKey;
+			uint32 index;
+			bool isPointDraw;
+		};
+
+		SimpleDrawCall& m_AddSimpleDrawCall();
+		void m_AddCommand(uint32 index, bool isPointDraw, const Mesh& mesh, const Material& mat, const MaterialParameterSet& params);
+
 		RenderState m_renderState;
-		Vector<RenderQueueItem*> m_orderedCommands;
+		RenderQueueSortMode m_sortMode = RenderQueueSortMode::Submission;
+		// Linear storage for the draw calls, reused between Process calls
+		Vector<SimpleDrawCall> m_simpleDrawCalls;
+		Vector<PointDrawCall> m_pointDrawCalls;
+		Vector<Command> m_orderedCommands;
+		// Current layer for sort keys, and whether the last command can be reordered with the next
+		uint32 m_currentLayer = 0;
+		bool m_lastCommandUnordered = false;
 		class OpenGL* m_ogl = nullptr;
 	};
-}
\ No newline at end of file
+}
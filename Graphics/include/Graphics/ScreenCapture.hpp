@@ -0,0 +1,67 @@
+#pragma once
+#include <Graphics/Image.hpp>
+
+#ifdef None
+#undef None
+#endif
+#include <Shared/Jobs.hpp>
+
+namespace Graphics
+{
+	/*
+		Reads back a region of the back buffer without stalling the frame
+		The pixels are copied into a pixel buffer and only mapped once a fence signals that the copy has completed
+	*/
+	class ScreenCapture : public Unique
+	{
+	public:
+		// Queues the readback of the given region of the back buffer
+		ScreenCapture(class OpenGL* gl, Vector2i size, Vector2i pos = Vector2i());
+		~ScreenCapture();
+
+		// Returns true once the image is available or the capture has failed
+		bool Poll();
+		// The captured image, bottom row first, null if the capture failed
+		Ref<ImageRes> GetImage() const { return m_image; }
+
+	private:
+		void m_Release();
+
+		class OpenGL* m_gl;
+		Vector2i m_size;
+		Ref<ImageRes> m_image;
+		uint32 m_pixelBuffer = 0;
+		void* m_fence = nullptr;
+		bool m_done = false;
+	};
+
+	/*
+		Captures a region of the back buffer and writes it to a PNG file on a job
+		Call Update every frame until the capture has been handed off
+	*/
+	class ScreenshotSaver : public Unique
+	{
+	public:
+		ScreenshotSaver(class OpenGL* gl, class JobSheduler* sheduler, const String& path, Vector2i size, Vector2i pos = Vector2i(), int32 compressionLevel = -1);
+		~ScreenshotSaver();
+
+		// Queues the save job once the readback has completed
+		void Update();
+		// True once OnSaved has been called
+		bool IsDone() const { return m_done; }
+
+		// Called with the path of the saved file, or an error message if the capture failed
+		Delegate<const String&> OnSaved;
+
+	private:
+		void m_OnJobFinished(Job& job);
+		void m_Finish(const String& result);
+
+		class JobSheduler* m_sheduler;
+		Ref<ScreenCapture> m_capture;
+		Job m_job;
+		String m_path;
+		int32 m_compressionLevel;
+		bool m_done = false;
+	};
+}
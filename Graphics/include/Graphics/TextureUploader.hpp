@@ -0,0 +1,33 @@
+#pragma once
+#include <Graphics/Image.hpp>
+
+namespace Graphics
+{
+	/*
+		Streams image data into existing RGBA8 textures through a pixel buffer object
+		Keeps track of the bytes uploaded each frame so callers can spread large batches of uploads over multiple frames
+	*/
+	class TextureUploader : public Unique
+	{
+	public:
+		TextureUploader(class OpenGL* gl, size_t frameBudget);
+		~TextureUploader();
+
+		// Resets the per frame budget, call once per frame
+		void NewFrame();
+		// Checks if an upload of this many bytes fits in the budget of this frame
+		//	the first upload of a frame is always allowed so large images can't stall the queue
+		bool HasBudget(size_t bytes) const;
+		// Uploads an image into a texture handle of the same size
+		void Upload(uint32 textureHandle, const Ref<ImageRes>& image);
+		// Defines the base level of a texture handle from compressed block data in the given format
+		void UploadCompressed(uint32 textureHandle, Vector2i size, uint32 format, const Buffer& data);
+
+	private:
+		class OpenGL* m_gl;
+		uint32 m_pixelBuffer = 0;
+		size_t m_frameBudget;
+		size_t m_frameBytes = 0;
+		uint32 m_frameUploads = 0;
+	};
+}
@@ -16,44 +16,144 @@ namespace Graphics
 	using Shared::Margin;
 	using Shared::Recti;
 
+	struct TextVertex : public VertexFormat<Vector2, Vector2>
+	{
+		TextVertex(Vector2 point, Vector2 uv) : pos(point), tex(uv) {}
+		Vector2 pos;
+		Vector2 tex;
+	};
+
+	// Placement of the glyphs of a text, independent of the atlas page and mesh it ends up in
+	struct TextLayout
+	{
+		struct Quad
+		{
+			uint32 glyph;
+			Vector2 offset;
+		};
+		Vector<Quad> quads;
+		// Distinct glyphs that are visible in this text
+		Vector<uint32> glyphs;
+		Vector2 size;
+	};
+
 	struct CachedText
 	{
+		WString key;
+		uint32 options;
+		TextLayout layout;
 		Text text;
 		float lastUsage;
+		uint32 lastUsedFrame;
+		// Estimated CPU + GPU memory used by this entry
+		size_t memory;
 	};
+
 	// Prevents continuous recreation of text that doesn't change
-	class TextCache : public Map<WString, CachedText>
+	//	entries are kept in least recently used order and dropped after not being used for a second,
+	//	or earlier when the cache goes over its memory budget
+	class TextCache
 	{
 		Timer timer;
+		std::list<CachedText> m_entries;
+		// The same string can be cached with different options
+		typedef std::pair<WString, uint32> Key;
+		Map<Key, std::list<CachedText>::iterator> m_lookup;
+		size_t m_memoryUsage = 0;
+		// Meshes of dropped text that can be filled again, so short lived text doesn't create new GL objects
+		Vector<Mesh> m_freeMeshes;
+
 	public:
-		void Update()
+		static const size_t memoryBudget = 2 * 1024 * 1024;
+		static const size_t maxFreeMeshes = 64;
+
+		void Update(uint32 frame)
 		{
 			float currentTime = timer.SecondsAsFloat();
-			for(auto it = begin(); it != end();)
+			while(!m_entries.empty())
 			{
-				float durationSinceUsed = currentTime - it->second.lastUsage;
-				if(durationSinceUsed > 1.0f)
-				{
-					it = erase(it);
-					continue;
-				}
-				it++;
+				CachedText& oldest = m_entries.back();
+				float durationSinceUsed = currentTime - oldest.lastUsage;
+				if(durationSinceUsed <= 1.0f && m_memoryUsage <= memoryBudget)
+					break;
+				// Text used this frame can still be waiting in a render queue
+				if(oldest.lastUsedFrame == frame)
+					break;
+				m_RemoveOldest();
 			}
 		}
-		Text GetText(const WString& key)
+		CachedText* GetText(const WString& key, uint32 options, uint32 frame)
 		{
-			auto it = find(key);
-			if(it != end())
+			auto it = m_lookup.find(Key(key, options));
+			if(it == m_lookup.end())
+				return nullptr;
+
+			// Move to the front of the usage list
+			m_entries.splice(m_entries.begin(), m_entries, it->second);
+			CachedText& entry = m_entries.front();
+			entry.lastUsage = timer.SecondsAsFloat();
+			entry.lastUsedFrame = frame;
+			return &entry;
+		}
+		CachedText& AddText(const WString& key, uint32 options, TextLayout&& layout, uint32 frame)
+		{
+			Update(frame);
+
+			m_entries.emplace_front();
+			CachedText& entry = m_entries.front();
+			entry.key = key;
+			entry.options = options;
+			entry.layout = std::move(layout);
+			entry.lastUsage = timer.SecondsAsFloat();
+			entry.lastUsedFrame = frame;
+			entry.memory = key.size() * sizeof(wchar_t)
+				+ entry.layout.quads.size() * (sizeof(TextLayout::Quad) + sizeof(TextVertex) * 6)
+				+ entry.layout.glyphs.size() * sizeof(uint32);
+			m_memoryUsage += entry.memory;
+			m_lookup.Add(Key(key, options), m_entries.begin());
+			return entry;
+		}
+		// Returns a mesh that is no longer used by any text, or a new one
+		Mesh TakeMesh(OpenGL* gl)
+		{
+			if(m_freeMeshes.empty())
+			{
+				Mesh mesh = MeshRes::Create(gl);
+				mesh->SetPrimitiveType(PrimitiveType::TriangleList);
+				return mesh;
+			}
+			Mesh mesh = m_freeMeshes.back();
+			m_freeMeshes.pop_back();
+			return mesh;
+		}
+		// Number of texts on a page that only the cache references, these can be rebuilt when the page is cleared
+		uint32 CountUnsharedTexts(uint32 page, uint32 generation) const
+		{
+			uint32 count = 0;
+			for(const CachedText& entry : m_entries)
 			{
-				it->second.lastUsage = timer.SecondsAsFloat();
-				return it->second.text;
+				const Text& text = entry.text;
+				if(text && text.use_count() == 1 && text->page == page && text->pageGeneration == generation)
+					count++;
 			}
-			return Text();
+			return count;
 		}
-		void AddText(const WString& key, Text obj)
+		// Returns the mesh of text to the pool if nothing outside of the cache is referencing it
+		void ReleaseText(Text& text)
 		{
-			Update();
-			Add(key, { obj, timer.SecondsAsFloat() });
+			if(text && text.use_count() == 1 && m_freeMeshes.size() < maxFreeMeshes)
+				m_freeMeshes.Add(text->GetMesh());
+			text.reset();
+		}
+
+	private:
+		void m_RemoveOldest()
+		{
+			CachedText& oldest = m_entries.back();
+			ReleaseText(oldest.text);
+			m_memoryUsage -= oldest.memory;
+			m_lookup.erase(Key(oldest.key, oldest.options));
+			m_entries.pop_back();
 		}
 	};
 
@@ -73,51 +173,152 @@ namespace Graphics
 		float advance;
 		int32 leftOffset;
 		int32 topOffset;
-		Recti coords;
+		// Rendered glyph, kept so it can be placed on another atlas page without rendering it again
+		Image image;
+		Vector2i size;
+	};
+
+	// Fixed size atlas texture, glyphs are packed into shelves (rows) of similar height
+	struct GlyphPage
+	{
+		struct Shelf
+		{
+			int32 y;
+			int32 height;
+			int32 x;
+		};
+
+		Texture texture;
+		Vector<Shelf> shelves;
+		int32 nextShelfY = 0;
+		// Location of glyphs currently on this page, by index in FontSize::infos
+		Map<uint32, Vector2i> glyphs;
+		// Incremented whenever the page is cleared, text created for an older generation is invalid
+		uint32 generation = 0;
+		// Text objects alive for the current generation, including the ones only held by the cache
+		Ref<uint32> liveTexts = Utility::MakeRef(new uint32(0));
+		uint32 lastUsedFrame = 0;
 	};
+
 	struct FontSize
 	{
-		SpriteMap spriteMap;
-		Texture textureMap;
+		// Pages are only evicted once this many exist
+		static const uint32 maxPages = 4;
+		// Padding between glyphs on a page
+		static const int32 glyphPadding = 1;
+
 		FT_Face face;
 		Vector<CharInfo> infos;
 		Map<wchar_t, uint32> infoByChar;
-		bool bUpdated = false;
+		Vector<GlyphPage> pages;
+		int32 pageSize;
+		uint32 currentPage = 0;
 		float lineHeight;
 		TextCache cache;
 
-		FontSize(OpenGL* gl, FT_Face& face)
+		FontSize(OpenGL* gl, FT_Face& face, uint32 nSize)
 			: face(face), m_gl(gl)
 		{
-			spriteMap = SpriteMapRes::Create();
-			textureMap = TextureRes::Create(m_gl);
 			lineHeight = (float)face->size->metrics.height / 64.0f;
+
+			// Room for about 256 glyphs of this size per page
+			pageSize = 256;
+			while(pageSize < (int32)nSize * 16 && pageSize < 2048)
+				pageSize *= 2;
 		}
 		~FontSize()
 		{
 		}
 
-		const CharInfo& GetCharInfo(wchar_t t)
+		uint32 GetCharIndex(wchar_t t)
 		{
 			auto it = infoByChar.find(t);
 			if(it == infoByChar.end())
 				return AddCharInfo(t);
-			return infos[it->second];
+			return it->second;
+		}
+		const CharInfo& GetCharInfo(wchar_t t)
+		{
+			return infos[GetCharIndex(t)];
 		}
-		Texture GetTextureMap()
+
+		// Selects a page that contains all the given glyphs, adding missing ones to it
+		uint32 PlaceGlyphs(const Vector<uint32>& glyphs)
 		{
-			if(bUpdated)
+			uint32 frame = m_gl->GetFrameIndex();
+
+			// Check if any page already contains everything
+			for(uint32 i = 0; i < pages.size(); i++)
+			{
+				uint32 pageIndex = (currentPage + i) % pages.size();
+				GlyphPage& page = pages[pageIndex];
+				bool complete = true;
+				for(uint32 glyph : glyphs)
+				{
+					if(!page.glyphs.Contains(glyph))
+					{
+						complete = false;
+						break;
+					}
+				}
+				if(complete)
+				{
+					page.lastUsedFrame = frame;
+					return pageIndex;
+				}
+			}
+
+			// Try to add the missing glyphs to the page that was filled last
+			if(!pages.empty() && AddGlyphsToPage(currentPage, glyphs))
+				return currentPage;
+
+			// Use a new page, or clear the one that was used least recently
+			// when every page is still in use by held text a new page is added anyway
+			uint32 target = (uint32)pages.size();
+			if(pages.size() >= maxPages)
+			{
+				for(uint32 i = 0; i < pages.size(); i++)
+				{
+					// Text using pages from this frame may still be waiting in a render queue
+					if(pages[i].lastUsedFrame == frame)
+						continue;
+					if(target != pages.size() && pages[i].lastUsedFrame >= pages[target].lastUsedFrame)
+						continue;
+					// Text held outside of the cache (e.g. lua labels) is drawn without going through the cache
+					if(*pages[i].liveTexts > cache.CountUnsharedTexts(i, pages[i].generation))
+						continue;
+					target = i;
+				}
+			}
+			if(target == pages.size())
+			{
+				pages.emplace_back();
+				pages.back().texture = TextureRes::Create(m_gl);
+				pages.back().texture->Init(Vector2i(pageSize), TextureFormat::RGBA8);
+			}
+			else
 			{
-				textureMap = spriteMap->GenerateTexture(m_gl);
-				bUpdated = false;
+				ClearPage(pages[target]);
 			}
-			return textureMap;
+
+			currentPage = target;
+			if(!AddGlyphsToPage(target, glyphs))
+				Logf("Text does not fit on a single font atlas page (%d glyphs)", Logger::Severity::Warning, (int32)glyphs.size());
+			return target;
+		}
+
+		// Returns the location of a glyph on a page, glyphs that didn't fit return a zero size quad
+		Vector2i GetGlyphPosition(uint32 pageIndex, uint32 glyph)
+		{
+			Vector2i* pos = pages[pageIndex].glyphs.Find(glyph);
+			return pos ? *pos : Vector2i(-1);
 		}
+
 	private:
-		const CharInfo& AddCharInfo(wchar_t t)
+		uint32 AddCharInfo(wchar_t t)
 		{
-			bUpdated = true;
-			infoByChar.Add(t, (uint32)infos.size());
+			uint32 index = (uint32)infos.size();
+			infoByChar.Add(t, index);
 			infos.emplace_back();
 			CharInfo& ci = infos.back();
 
@@ -139,8 +340,12 @@ namespace Graphics
 			ci.topOffset = (*pFace)->glyph->bitmap_top;
 			ci.leftOffset = (*pFace)->glyph->bitmap_left;
 			ci.advance = (float)(*pFace)->glyph->advance.x / 64.0f;
+			ci.size = Vector2i((*pFace)->glyph->bitmap.width, (*pFace)->glyph->bitmap.rows);
+
+			if(ci.size.x == 0 || ci.size.y == 0)
+				return index;
 
-			Image img = ImageRes::Create(Vector2i((*pFace)->glyph->bitmap.width, (*pFace)->glyph->bitmap.rows));
+			Image img = ImageRes::Create(ci.size);
 			Colori* pDst = img->GetBits();
 			uint8* pSrc = (*pFace)->glyph->bitmap.buffer;
 			uint32 nLen = (*pFace)->glyph->bitmap.width * (*pFace)->glyph->bitmap.rows;
@@ -151,10 +356,72 @@ namespace Graphics
 				pSrc++;
 				pDst++;
 			}
-			uint32 nIndex = spriteMap->AddSegment(img);
-			ci.coords = spriteMap->GetCoords(nIndex);
+			ci.image = img;
+
+			return index;
+		}
+
+		bool AddGlyphsToPage(uint32 pageIndex, const Vector<uint32>& glyphs)
+		{
+			GlyphPage& page = pages[pageIndex];
+			page.lastUsedFrame = m_gl->GetFrameIndex();
+			for(uint32 glyph : glyphs)
+			{
+				if(page.glyphs.Contains(glyph))
+					continue;
+
+				const CharInfo& info = infos[glyph];
+				Vector2i pos;
+				if(!AllocateRegion(page, info.size, pos))
+					return false;
+
+				page.texture->SetSubData(pos, info.size, info.image->GetBits());
+				page.glyphs.Add(glyph, pos);
+				m_gl->m_renderStats.glyphUploads++;
+			}
+			return true;
+		}
+
+		bool AllocateRegion(GlyphPage& page, Vector2i size, Vector2i& pos)
+		{
+			Vector2i paddedSize = size + Vector2i(glyphPadding);
+			if(paddedSize.x > pageSize || paddedSize.y > pageSize)
+				return false;
+
+			// Use the lowest shelf that fits, without wasting too much height
+			GlyphPage::Shelf* best = nullptr;
+			for(GlyphPage::Shelf& shelf : page.shelves)
+			{
+				if(shelf.height < paddedSize.y || shelf.x + paddedSize.x > pageSize)
+					continue;
+				if(shelf.height > paddedSize.y * 2)
+					continue;
+				if(!best || shelf.height < best->height)
+					best = &shelf;
+			}
+
+			if(!best)
+			{
+				if(page.nextShelfY + paddedSize.y > pageSize)
+					return false;
+				page.shelves.push_back({ page.nextShelfY, paddedSize.y, 0 });
+				page.nextShelfY += paddedSize.y;
+				best = &page.shelves.back();
+			}
 
-			return ci;
+			pos = Vector2i(best->x, best->y);
+			best->x += paddedSize.x;
+			return true;
+		}
+
+		void ClearPage(GlyphPage& page)
+		{
+			page.shelves.clear();
+			page.nextShelfY = 0;
+			page.glyphs.clear();
+			page.generation++;
+			// Text of the previous generation keeps counting on the old counter
+			page.liveTexts = Utility::MakeRef(new uint32(0));
 		}
 
 		OpenGL* m_gl;
@@ -163,11 +430,13 @@ namespace Graphics
 
 	TextRes::~TextRes()
 	{
+		if(pageTexts)
+			(*pageTexts)--;
 	}
 
 	Ref<class TextureRes> TextRes::GetTexture()
 	{
-		return fontSize->GetTextureMap();
+		return texture;
 	}
 	void TextRes::Draw()
 	{
@@ -242,74 +511,74 @@ namespace Graphics
 			if(it != m_sizes.end())
 				return it->second;
 
-			FontSize* pMap = new FontSize(m_gl, m_face);
+			FontSize* pMap = new FontSize(m_gl, m_face, nSize);
 			m_sizes.Add(nSize, pMap);
 			return pMap;
 		}
 		Ref<TextRes> CreateText(const WString& str, uint32 nFontSize, TextOptions options)
 		{
 			FontSize* size = GetSize(nFontSize);
+			uint32 frame = m_gl->GetFrameIndex();
 
-			Text cachedText = size->cache.GetText(str);
+			CachedText* cachedText = size->cache.GetText(str, options, frame);
 			if(cachedText)
-				return cachedText;
-
-			struct TextVertex : public VertexFormat<Vector2, Vector2>
 			{
-				TextVertex(Vector2 point, Vector2 uv) : pos(point), tex(uv) {}
-				Vector2 pos;
-				Vector2 tex;
-			};
+				// Only valid if the page it was placed on has not been cleared since
+				Text& text = cachedText->text;
+				GlyphPage& page = size->pages[text->page];
+				if(page.generation == text->pageGeneration)
+				{
+					page.lastUsedFrame = frame;
+					return text;
+				}
 
-			TextRes* ret = new TextRes();
-			ret->mesh = MeshRes::Create(m_gl);
+				// Keep the layout, only the mesh has to be rebuilt on a new page
+				size->cache.ReleaseText(text);
+				text = BuildText(size, cachedText->layout);
+				return text;
+			}
+
+			CachedText& entry = size->cache.AddText(str, options, LayoutText(size, str, nFontSize, options), frame);
+			entry.text = BuildText(size, entry.layout);
+			return entry.text;
+		}
+
+	private:
+		TextLayout LayoutText(FontSize* size, const WString& str, uint32 nFontSize, TextOptions options)
+		{
+			TextLayout layout;
+			layout.quads.reserve(str.size());
 
 			float monospaceWidth = size->GetCharInfo(L'_').advance;
 
-			Vector<TextVertex> vertices;
 			Vector2 pen;
 			for(wchar_t c : str)
 			{
-				const CharInfo& info = size->GetCharInfo(c);
+				uint32 glyph = size->GetCharIndex(c);
+				const CharInfo& info = size->infos[glyph];
 
-				if(c != L'\n' && c != L'\t' && info.coords.size.x != 0 && info.coords.size.y != 0)
+				if(c != L'\n' && c != L'\t' && info.size.x != 0 && info.size.y != 0)
 				{
-					Vector2 corners[4];
-					corners[0] = Vector2(0, 0);
-					corners[1] = Vector2((float)info.coords.size.x, 0);
-					corners[2] = Vector2((float)info.coords.size.x, (float)info.coords.size.y);
-					corners[3] = Vector2(0, (float)info.coords.size.y);
-
 					Vector2 offset = Vector2(pen.x, pen.y);
 					offset.x += info.leftOffset;
 					offset.y += nFontSize - info.topOffset;
 					if((options & TextOptions::Monospace) != 0)
 					{
-						offset.x += (monospaceWidth - info.coords.size.x) * 0.5f;
+						offset.x += (monospaceWidth - info.size.x) * 0.5f;
 					}
 					pen.x = floorf(pen.x);
 					pen.y = floorf(pen.y);
 
-					vertices.emplace_back(offset + corners[2],
-						corners[2] + info.coords.pos);
-					vertices.emplace_back(offset + corners[0],
-						corners[0] + info.coords.pos);
-					vertices.emplace_back(offset + corners[1],
-						corners[1] + info.coords.pos);
-
-					vertices.emplace_back(offset + corners[3],
-						corners[3] + info.coords.pos);
-					vertices.emplace_back(offset + corners[0],
-						corners[0] + info.coords.pos);
-					vertices.emplace_back(offset + corners[2],
-						corners[2] + info.coords.pos);
+					layout.quads.push_back({ glyph, offset });
+					if(std::find(layout.glyphs.begin(), layout.glyphs.end(), glyph) == layout.glyphs.end())
+						layout.glyphs.Add(glyph);
 				}
 
 				if(c == L'\n')
 				{
 					pen.x = 0.0f;
 					pen.y += size->lineHeight;
-					ret->size.y = pen.y;
+					layout.size.y = pen.y;
 				}
 				else if(c == L'\t')
 				{
@@ -323,21 +592,62 @@ namespace Graphics
 						pen.x += monospaceWidth;
 					}
 					else
-						pen.x += info.advance;
+						pen.x += size->infos[glyph].advance;
 				}
-				ret->size.x = std::max(ret->size.x, pen.x);
+				layout.size.x = std::max(layout.size.x, pen.x);
 			}
 
-			ret->size.y += size->lineHeight;
+			layout.size.y += size->lineHeight;
+			return layout;
+		}
 
-			ret->fontSize = size;
+		Text BuildText(FontSize* size, const TextLayout& layout)
+		{
+			// Make sure all visible glyphs are on the same atlas page
+			uint32 pageIndex = size->PlaceGlyphs(layout.glyphs);
+
+			Vector<TextVertex> vertices;
+			vertices.reserve(layout.quads.size() * 6);
+			for(const TextLayout::Quad& quad : layout.quads)
+			{
+				Vector2i glyphPos = size->GetGlyphPosition(pageIndex, quad.glyph);
+				if(glyphPos.x < 0)
+					continue;
+
+				Recti coords = Recti(glyphPos, size->infos[quad.glyph].size);
+				Vector2 corners[4];
+				corners[0] = Vector2(0, 0);
+				corners[1] = Vector2((float)coords.size.x, 0);
+				corners[2] = Vector2((float)coords.size.x, (float)coords.size.y);
+				corners[3] = Vector2(0, (float)coords.size.y);
+
+				const Vector2& offset = quad.offset;
+				vertices.emplace_back(offset + corners[2],
+					corners[2] + coords.pos);
+				vertices.emplace_back(offset + corners[0],
+					corners[0] + coords.pos);
+				vertices.emplace_back(offset + corners[1],
+					corners[1] + coords.pos);
+
+				vertices.emplace_back(offset + corners[3],
+					corners[3] + coords.pos);
+				vertices.emplace_back(offset + corners[0],
+					corners[0] + coords.pos);
+				vertices.emplace_back(offset + corners[2],
+					corners[2] + coords.pos);
+			}
+
+			TextRes* ret = new TextRes();
+			ret->size = layout.size;
+			ret->texture = size->pages[pageIndex].texture;
+			ret->page = pageIndex;
+			ret->pageGeneration = size->pages[pageIndex].generation;
+			ret->pageTexts = size->pages[pageIndex].liveTexts;
+			(*ret->pageTexts)++;
+			ret->mesh = size->cache.TakeMesh(m_gl);
 			ret->mesh->SetData(vertices);
-			ret->mesh->SetPrimitiveType(PrimitiveType::TriangleList);
 
-			Text textObj = Utility::MakeRef(ret);
-			// Insert into cache
-			size->cache.AddText(str, textObj);
-			return textObj;
+			return Utility::MakeRef(ret);
 		}
 	};
 
@@ -122,7 +122,7 @@ namespace Graphics
 			glDeleteTextures(1, &texture);
 			return true;
 		}
-		void SavePNG(const String& file)
+		void SavePNG(const String& file, int32 compressionLevel)
 		{
 			///TODO: Use shared/File.hpp instead?
 			File pngfile;
@@ -142,6 +142,8 @@ namespace Graphics
 			png_set_IHDR(png_ptr, info_ptr, m_size.x, m_size.y,
 				8, PNG_COLOR_TYPE_RGBA, PNG_INTERLACE_NONE,
 				PNG_COMPRESSION_TYPE_DEFAULT, PNG_FILTER_TYPE_DEFAULT);
+			if (compressionLevel >= 0)
+				png_set_compression_level(png_ptr, Math::Min(compressionLevel, 9));
 
 			png_bytep* row_pointers = (png_bytep*)malloc(sizeof(png_bytep) * m_size.y);
 			for (int i = 0; i < m_size.y; ++i) {
@@ -183,10 +185,10 @@ namespace Graphics
 		pImpl->SetSize(size);
 		return GetResourceManager<ResourceType::Image>().Register(pImpl);
 	}
-	Ref<ImageRes> ImageRes::Create(Buffer & b)
+	Ref<ImageRes> ImageRes::Create(Buffer & b, Vector2i minSize)
 	{
 		Image_Impl* pImpl = new Image_Impl();
-		if (ImageLoader::Load(pImpl, b))
+		if (ImageLoader::Load(pImpl, b, minSize))
 		{
 			return GetResourceManager<ResourceType::Image>().Register(pImpl);
 		}
@@ -197,10 +199,10 @@ namespace Graphics
 		}
 		return Image();
 	}
-	Image ImageRes::Create(const String& assetPath)
+	Image ImageRes::Create(const String& assetPath, Vector2i minSize)
 	{
 		Image_Impl* pImpl = new Image_Impl();
-		if(ImageLoader::Load(pImpl, assetPath))
+		if(ImageLoader::Load(pImpl, assetPath, minSize))
 		{
 			return GetResourceManager<ResourceType::Image>().Register(pImpl);
 		}
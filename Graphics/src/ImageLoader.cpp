@@ -46,7 +46,7 @@ namespace Graphics
 		{
 		}
 
-		bool LoadJPEG(ImageRes* pImage, Buffer& in)
+		bool LoadJPEG(ImageRes* pImage, Buffer& in, Vector2i minSize)
 		{
 
 			/* This struct contains the JPEG decompression parameters and pointers to
@@ -68,28 +68,106 @@ namespace Graphics
 				jpeg_mem_src(&cinfo, in.data(), (uint32)in.size());
 				int res = jpeg_read_header(&cinfo, TRUE);
 
+				// Let the decoder scale down in the DCT domain, as far as the result stays at least minSize
+				if(minSize.x > 0 && minSize.y > 0)
+				{
+					for(uint32 denom = 8; denom > 1; denom /= 2)
+					{
+						if(cinfo.image_width / denom >= (uint32)minSize.x && cinfo.image_height / denom >= (uint32)minSize.y)
+						{
+							cinfo.scale_num = 1;
+							cinfo.scale_denom = denom;
+							break;
+						}
+					}
+				}
+
+				// libjpeg-turbo can write RGBA directly for sources it converts to RGB,
+				// everything else is decoded in its default output space and expanded below
+				bool directRGBA = false;
+#ifdef JCS_EXTENSIONS
+				if(cinfo.jpeg_color_space == JCS_YCbCr || cinfo.jpeg_color_space == JCS_RGB || cinfo.jpeg_color_space == JCS_GRAYSCALE)
+				{
+					cinfo.out_color_space = JCS_EXT_RGBA;
+					directRGBA = true;
+				}
+#endif
 				jpeg_start_decompress(&cinfo);
-				int row_stride = cinfo.output_width * cinfo.output_components;
-				JSAMPARRAY sample = (*cinfo.mem->alloc_sarray)
-					((j_common_ptr)&cinfo, JPOOL_IMAGE, row_stride, 1);
 
 				Vector2i size = Vector2i(cinfo.output_width, cinfo.output_height);
 				pImage->SetSize(size);
 				Colori* pBits = pImage->GetBits();
 
-				size_t pixelSize = cinfo.out_color_components;
-				cinfo.out_color_space = JCS_RGB;
-
-				while(cinfo.output_scanline < cinfo.output_height)
+				// Read as many scanlines per call as the decoder can produce at once
+				const uint32 batchSize = Math::Max(1, cinfo.rec_outbuf_height);
+				if(directRGBA)
 				{
-					jpeg_read_scanlines(&cinfo, sample, 1);
-					for(size_t i = 0; i < cinfo.output_width; i++)
+					JSAMPROW rows[8];
+					assert(batchSize <= 8);
+					while(cinfo.output_scanline < cinfo.output_height)
 					{
-						memcpy(pBits + i, sample[0] + i * pixelSize, pixelSize);
-						pBits[i].w = 0xFF;
+						for(uint32 i = 0; i < batchSize; i++)
+						{
+							uint32 row = Math::Min(cinfo.output_scanline + i, cinfo.output_height - 1);
+							rows[i] = (JSAMPROW)(pBits + row * size.x);
+						}
+						jpeg_read_scanlines(&cinfo, rows, batchSize);
 					}
+				}
+				else
+				{
+					const uint32 components = cinfo.output_components;
+					int row_stride = cinfo.output_width * components;
+					JSAMPARRAY sample = (*cinfo.mem->alloc_sarray)
+						((j_common_ptr)&cinfo, JPOOL_IMAGE, row_stride, batchSize);
 
-					pBits += size.x;
+					while(cinfo.output_scanline < cinfo.output_height)
+					{
+						uint32 numRows = jpeg_read_scanlines(&cinfo, sample, batchSize);
+						for(uint32 row = 0; row < numRows; row++)
+						{
+							// Expand to RGBA, each loop kept branch free so it can be vectorized
+							const uint8* pSrc = sample[row];
+							uint8* pDst = (uint8*)pBits;
+							if(components == 1)
+							{
+								for(uint32 i = 0; i < cinfo.output_width; i++)
+								{
+									pDst[0] = pDst[1] = pDst[2] = pSrc[0];
+									pDst[3] = 0xFF;
+									pSrc += 1;
+									pDst += 4;
+								}
+							}
+							else if(components == 3)
+							{
+								for(uint32 i = 0; i < cinfo.output_width; i++)
+								{
+									pDst[0] = pSrc[0];
+									pDst[1] = pSrc[1];
+									pDst[2] = pSrc[2];
+									pDst[3] = 0xFF;
+									pSrc += 3;
+									pDst += 4;
+								}
+							}
+							else if(components == 4)
+							{
+								// CMYK (and YCCK converted to CMYK), stored inverted as written by Adobe applications
+								for(uint32 i = 0; i < cinfo.output_width; i++)
+								{
+									uint32 k = pSrc[3];
+									pDst[0] = (uint8)(pSrc[0] * k / 255);
+									pDst[1] = (uint8)(pSrc[1] * k / 255);
+									pDst[2] = (uint8)(pSrc[2] * k / 255);
+									pDst[3] = 0xFF;
+									pSrc += 4;
+									pDst += 4;
+								}
+							}
+							pBits += size.x;
+						}
+					}
 				}
 
 				jpeg_finish_decompress(&cinfo);
@@ -98,6 +176,7 @@ namespace Graphics
 			}
 			
 			// If we get here, the loading of the jpeg failed
+			jpeg_destroy_decompress(&cinfo);
 			return false;
 		}
 		bool LoadPNG(ImageRes* pImage, Buffer& in)
@@ -125,7 +204,7 @@ namespace Graphics
 			png_image_free(&image);
 			return true;
 		}
-		bool Load(ImageRes* pImage, const String& fullPath)
+		bool Load(ImageRes* pImage, const String& fullPath, Vector2i minSize)
 		{
 			File f;
 			if(!f.OpenRead(fullPath))
@@ -136,16 +215,16 @@ namespace Graphics
 			if(b.size() < 4)
 				return false;
 
-			return Load(pImage, b);
+			return Load(pImage, b, minSize);
 		}
 
-		bool Load(ImageRes* pImage, Buffer& b)
+		bool Load(ImageRes* pImage, Buffer& b, Vector2i minSize)
 		{
 			// Check for PNG based on first 4 bytes
 			if (std::memcmp(b.data(), "\x89PNG", 4) == 0)
 				return LoadPNG(pImage, b);
 			else // jay-PEG ?
-				return LoadJPEG(pImage, b);
+				return LoadJPEG(pImage, b, minSize);
 		}
 
 		static ImageLoader_Impl& Main()
@@ -156,13 +235,13 @@ namespace Graphics
 	};
 
 
-	bool ImageLoader::Load(ImageRes* pImage, const String& fullPath)
+	bool ImageLoader::Load(ImageRes* pImage, const String& fullPath, Vector2i minSize)
 	{
-		return ImageLoader_Impl::Main().Load(pImage, fullPath);
+		return ImageLoader_Impl::Main().Load(pImage, fullPath, minSize);
 	}
 
-	bool ImageLoader::Load(ImageRes* pImage, Buffer& b)
+	bool ImageLoader::Load(ImageRes* pImage, Buffer& b, Vector2i minSize)
 	{
-		return ImageLoader_Impl::Main().Load(pImage, b);
+		return ImageLoader_Impl::Main().Load(pImage, b, minSize);
 	}
 }
\ No newline at end of file
@@ -17,7 +17,7 @@ namespace Graphics
 		SV_AspectRatio,
 		SV_Time,
 		SV__BuiltInEnd,
-		SV_User = 0x100, // Start defining user variables here
+		SV_User = SV__BuiltInEnd, // Start defining user variables here
 	};
 	const char* builtInShaderVariableNames[] =
 	{
@@ -52,11 +52,23 @@ namespace Graphics
 		ShaderType shaderType;
 		uint32 paramType;
 		uint32 location;
+
+		// Last value uploaded to this uniform, uniforms keep their value in the program so unchanged values are skipped
+		uint8 lastValue[64];
+		uint32 lastSize = 0;
 	};
 	struct BoundParameterList : public Vector<BoundParameterInfo>
 	{
 	};
 
+	// Everything bound to a single parameter name, resolved once when the shaders are assigned
+	struct ParameterSlot
+	{
+		BoundParameterList bindings;
+		// Texture unit for sampler parameters
+		int32 textureUnit = -1;
+	};
+
 	// Defined in Shader.cpp
 	extern uint32 shaderStageMap[];
 
@@ -73,9 +85,9 @@ namespace Graphics
 #else
 		uint32 m_pipeline;
 #endif
-		Map<uint32, BoundParameterList> m_boundParameters;
+		// Indexed by built in variable or by the id in m_mappedParameters
+		Vector<ParameterSlot> m_slots;
 		Map<String, uint32> m_mappedParameters;
-		Map<String, uint32> m_textureIDs;
 		uint32 m_userID = SV_User;
 		uint32 m_textureID = 0;
 		Set<String> m_uniforms;
@@ -119,6 +131,8 @@ namespace Graphics
 #else
 			glGetProgramiv(handle, GL_ACTIVE_UNIFORMS, &numUniforms);
 #endif
+			if(m_slots.size() < SV__BuiltInEnd)
+				m_slots.resize(SV__BuiltInEnd);
 			
 			for(int32 i = 0; i < numUniforms; i++)
 			{
@@ -134,13 +148,10 @@ namespace Graphics
 				#endif
 				m_uniforms.Add(name);
 				// Select type
-				uint32 textureID = 0;
 				String typeName = "Unknown";
 				if(type == GL_SAMPLER_2D)
 				{
 					typeName = "Sampler2D";
-					if(!m_textureIDs.Contains(name))
-						m_textureIDs.Add(name, m_textureID++);
 				}
 				else if(type == GL_FLOAT_MAT4)
 				{
@@ -174,10 +185,16 @@ namespace Graphics
 					if(m_mappedParameters.Contains(name))
 						targetID = m_mappedParameters[name];
 					else
+					{
 						targetID = m_mappedParameters.Add(name, m_userID++);
+						m_slots.resize(m_userID);
+					}
 				}
 
-				BoundParameterInfo& param = m_boundParameters.FindOrAdd(targetID).Add(BoundParameterInfo(t, type, loc));
+				ParameterSlot& slot = m_slots[targetID];
+				if(type == GL_SAMPLER_2D && slot.textureUnit < 0)
+					slot.textureUnit = (int32)m_textureID++;
+				slot.bindings.Add(BoundParameterInfo(t, type, loc));
 
 #ifdef _DEBUG
 				Logf("Uniform [%d, loc=%d, %s] = %s", Logger::Severity::Info,
@@ -206,8 +223,7 @@ namespace Graphics
 			if(reloadedShaders)
 			{
 				Log("Reloading material", Logger::Severity::Info);
-				m_boundParameters.clear();
-				m_textureIDs.clear();
+				m_slots.clear();
 				m_mappedParameters.clear();
 				m_userID = SV_User;
 				m_textureID = 0;
@@ -224,13 +240,16 @@ namespace Graphics
 			#ifdef EMBEDDED
 			BindToContext();
 			#endif
-			// Bind renderstate variables
+			// Bind renderstate variables, these are skipped when they did not change since the last bind
 			BindAll(SV_Proj, rs.projectionTransform);
 			BindAll(SV_Camera, rs.cameraTransform);
 			BindAll(SV_Viewport, rs.viewportSize);
 			BindAll(SV_AspectRatio, rs.aspectRatio);
-			Transform billboard = CameraMatrix::BillboardMatrix(rs.cameraTransform);
-			BindAll(SV_BillboardMatrix, billboard);
+			if(!m_slots.empty() && !m_slots[SV_BillboardMatrix].bindings.empty())
+			{
+				Transform billboard = CameraMatrix::BillboardMatrix(rs.cameraTransform);
+				BindAll(SV_BillboardMatrix, billboard);
+			}
 			BindAll(SV_Time, rs.time);
 			
 			// Bind parameters
@@ -244,54 +263,59 @@ namespace Graphics
 		void BindParameters(const MaterialParameterSet& params, const Transform& worldTransform) override
 		{
 			BindAll(SV_World, worldTransform);
-			for(auto p : params)
+			for(const auto& p : params)
 			{
+				// Parameters not used by any of the shaders are ignored
+				uint32* slot = m_mappedParameters.Find(p.first);
+				if(!slot)
+					continue;
+
 				switch(p.second.parameterType)
 				{
 				case GL_INT:
-					BindAll(p.first, p.second.Get<int>());
+					BindSlot(*slot, p.second.Get<int>());
 					break;
 				case GL_FLOAT:
-					BindAll(p.first, p.second.Get<float>());
+					BindSlot(*slot, p.second.Get<float>());
 					break;
 				case GL_INT_VEC2:
-					BindAll(p.first, p.second.Get<Vector2i>());
+					BindSlot(*slot, p.second.Get<Vector2i>());
 					break;
 				case GL_INT_VEC3:
-					BindAll(p.first, p.second.Get<Vector3i>());
+					BindSlot(*slot, p.second.Get<Vector3i>());
 					break;
 				case GL_INT_VEC4:
-					BindAll(p.first, p.second.Get<Vector4i>());
+					BindSlot(*slot, p.second.Get<Vector4i>());
 					break;
 				case GL_FLOAT_VEC2:
-					BindAll(p.first, p.second.Get<Vector2>());
+					BindSlot(*slot, p.second.Get<Vector2>());
 					break;
 				case GL_FLOAT_VEC3:
-					BindAll(p.first, p.second.Get<Vector3>());
+					BindSlot(*slot, p.second.Get<Vector3>());
 					break;
 				case GL_FLOAT_VEC4:
-					BindAll(p.first, p.second.Get<Vector4>());
+					BindSlot(*slot, p.second.Get<Vector4>());
 					break;
 				case GL_FLOAT_MAT4:
-					BindAll(p.first, p.second.Get<Transform>());
+					BindSlot(*slot, p.second.Get<Transform>());
 					break;
 				case GL_SAMPLER_2D:
 				{
-					uint32* textureUnit = m_textureIDs.Find(p.first);
-					if(!textureUnit)
+					int32 textureUnit = m_slots[*slot].textureUnit;
+					if(textureUnit < 0)
 					{
 						/// TODO: Add print once mechanism for these kind of errors
 						//Logf("Texture not found \"%s\"", Logger::Warning, p.first);
 						break;
 					}
-					Ref<TextureRes> texture = p.second.Get<Ref<TextureRes>>();
+					const Ref<TextureRes>& texture = p.second.Get<Ref<TextureRes>>();
 
 					// Bind the texture
-					texture->Bind(*textureUnit);
+					texture->Bind(textureUnit);
 
 
 					// Bind sampler
-					BindAll<int32>(p.first, *textureUnit);
+					BindSlot<int32>(*slot, textureUnit);
 					break;
 				}
 				default:
@@ -315,46 +339,24 @@ namespace Graphics
 			return m_uniforms.Contains(name);
 		}
 
-		BoundParameterInfo* GetBoundParameters(const String& name, uint32& count)
-		{
-			uint32* mappedID = m_mappedParameters.Find(name);
-			if(!mappedID)
-				return nullptr;
-			return GetBoundParameters((BuiltInShaderVariable)*mappedID, count);
-		}
-		BoundParameterInfo* GetBoundParameters(BuiltInShaderVariable bsv, uint32& count)
+		template<typename T> void BindAll(BuiltInShaderVariable bsv, const T& obj)
 		{
-			BoundParameterList* l = m_boundParameters.Find(bsv);
-			if(!l)
-				return nullptr;
-			else
-			{
-				count = (uint32)l->size();
-				return l->data();
-			}
+			if((size_t)bsv < m_slots.size())
+				BindSlot<T>((uint32)bsv, obj);
 		}
-		template<typename T> void BindAll(const String& name, const T& obj)
-		{
-			uint32 num = 0;
-			#ifdef EMBEDDED
-			glUseProgram(m_program);
-			#endif
-			BoundParameterInfo* bp = GetBoundParameters(name, num);
-			for(uint32 i = 0; bp && i < num; i++)
-			{
-				BindShaderVar<T>(m_shaders[(size_t)bp[i].shaderType]->Handle(), bp[i].location, obj);
-			}
-		}
-		template<typename T> void BindAll(BuiltInShaderVariable bsv, const T& obj)
+		template<typename T> void BindSlot(uint32 slot, const T& obj)
 		{
-			uint32 num = 0;
+			static_assert(sizeof(T) <= sizeof(BoundParameterInfo::lastValue), "Shader uniform type too large");
 			#ifdef EMBEDDED
 			glUseProgram(m_program);
 			#endif
-			BoundParameterInfo* bp = GetBoundParameters(bsv, num);
-			for(uint32 i = 0; bp && i < num; i++)
+			for(BoundParameterInfo& bp : m_slots[slot].bindings)
 			{
-				BindShaderVar<T>(m_shaders[(size_t)bp[i].shaderType]->Handle(), bp[i].location, obj);
+				if(bp.lastSize == sizeof(T) && memcmp(bp.lastValue, &obj, sizeof(T)) == 0)
+					continue;
+				memcpy(bp.lastValue, &obj, sizeof(T));
+				bp.lastSize = sizeof(T);
+				BindShaderVar<T>(m_shaders[(size_t)bp.shaderType]->Handle(), bp.location, obj);
 			}
 		}
 
@@ -183,6 +183,18 @@ namespace Graphics
 		glFlush();
 		SDL_Window* sdlWnd = (SDL_Window*)m_window->Handle();
 		SDL_GL_SwapWindow(sdlWnd);
+
+		m_lastFrameRenderStats = m_renderStats;
+		m_renderStats = RenderStats();
+		m_frameIndex++;
+	}
+	const RenderStats& OpenGL::GetLastFrameRenderStats() const
+	{
+		return m_lastFrameRenderStats;
+	}
+	uint32 OpenGL::GetFrameIndex() const
+	{
+		return m_frameIndex;
 	}
 
 	#ifdef _WIN32
@@ -1,7 +1,6 @@
 #include "stdafx.h"
 #include "OpenGL.hpp"
 #include "ParticleSystem.hpp"
-#include "Mesh.hpp"
 #include "VertexFormat.hpp"
 #include <Graphics/ResourceManagers.hpp>
 
@@ -23,19 +22,45 @@ namespace Graphics
 		friend class ParticleEmitter;
 		Vector<Ref<ParticleEmitter>> m_emitters;
 
+		// Emitters drawn together with a single material/texture combination
+		struct Batch
+		{
+			Material material;
+			Texture texture;
+			Vector<ParticleEmitter*> emitters;
+			uint32 first = 0;
+			uint32 count = 0;
+		};
+		Vector<Batch> m_batches;
+		// Batches from this index onward are all additive and can be drawn in any order
+		size_t m_additiveRunStart = 0;
+
+		// Vertices of all emitters, streamed into a single buffer each frame
+		Vector<ParticleVertex> m_vertices;
+		uint32 m_buffer = 0;
+		uint32 m_vao = 0;
+		size_t m_bufferCapacity = 0;
+
 	public:
 		OpenGL* gl;
 
 	public:
+		~ParticleSystem_Impl()
+		{
+			if(m_buffer)
+				glDeleteBuffers(1, &m_buffer);
+			if(m_vao)
+				glDeleteVertexArrays(1, &m_vao);
+		}
 		virtual void Render(const class RenderState& rs, float deltaTime) override
 		{
-			// Enable blending for all particles
-			glEnable(GL_BLEND);
+			m_batches.clear();
+			m_additiveRunStart = 0;
 
 			// Tick all emitters and remove old ones
 			for(auto it = m_emitters.begin(); it != m_emitters.end();)
 			{
-				(*it)->Render(rs, deltaTime);
+				(*it)->Simulate(deltaTime);
 
 				if(it->use_count() == 1)
 				{
@@ -52,8 +77,56 @@ namespace Graphics
 					}
 				}
 
+				if((*it)->m_numParticles > 0)
+					m_AddToBatch(it->get());
 				it++;
 			}
+
+			// Gather the vertices of each batch into one contiguous range
+			m_vertices.clear();
+			for(Batch& batch : m_batches)
+			{
+				batch.first = (uint32)m_vertices.size();
+				for(ParticleEmitter* emitter : batch.emitters)
+					emitter->GenerateVertices(m_vertices);
+				batch.count = (uint32)m_vertices.size() - batch.first;
+			}
+			if(m_vertices.empty())
+				return;
+
+			if(!m_UploadVertices())
+				return;
+
+			// Enable blending for all particles
+			glEnable(GL_BLEND);
+			glBindVertexArray(m_vao);
+			for(Batch& batch : m_batches)
+			{
+				MaterialParameterSet params;
+				if(batch.texture)
+				{
+					params.SetParameter("mainTex", batch.texture);
+				}
+				batch.material->Bind(rs, params);
+
+				// Select blending mode based on material
+				switch(batch.material->blendMode)
+				{
+				case MaterialBlendMode::Normal:
+					glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+					break;
+				case MaterialBlendMode::Additive:
+					glBlendFunc(GL_SRC_ALPHA, GL_ONE);
+					break;
+				case MaterialBlendMode::Multiply:
+					glBlendFunc(GL_SRC_ALPHA, GL_SRC_COLOR);
+					break;
+				}
+
+				glDrawArrays(GL_POINTS, (int)batch.first, (int)batch.count);
+				gl->m_renderStats.drawCalls++;
+			}
+			glBindVertexArray(0);
 		}
 		Ref<ParticleEmitter> AddEmitter() override
 		{
@@ -68,6 +141,68 @@ namespace Graphics
 				em.reset();
 			}
 			m_emitters.clear();
+			m_batches.clear();
+		}
+
+	private:
+		void m_AddToBatch(ParticleEmitter* emitter)
+		{
+			// Normal and multiplied blending depend on draw order, so those only merge with the previous batch
+			bool additive = emitter->material->blendMode == MaterialBlendMode::Additive;
+			if(!m_batches.empty())
+			{
+				for(size_t i = additive ? m_additiveRunStart : m_batches.size() - 1; i < m_batches.size(); i++)
+				{
+					Batch& batch = m_batches[i];
+					if(batch.material == emitter->material && batch.texture == emitter->texture)
+					{
+						batch.emitters.Add(emitter);
+						return;
+					}
+				}
+			}
+
+			Batch& batch = m_batches.Add(Batch());
+			batch.material = emitter->material;
+			batch.texture = emitter->texture;
+			batch.emitters.Add(emitter);
+			if(!additive)
+				m_additiveRunStart = m_batches.size();
+		}
+		bool m_UploadVertices()
+		{
+			// Created on first use, since the system itself may be created on a loading thread
+			if(!m_vao)
+			{
+				glGenBuffers(1, &m_buffer);
+				glGenVertexArrays(1, &m_vao);
+				if(m_buffer == 0 || m_vao == 0)
+					return false;
+
+				glBindVertexArray(m_vao);
+				glBindBuffer(GL_ARRAY_BUFFER, m_buffer);
+				const int stride = (int)sizeof(ParticleVertex);
+				glVertexAttribPointer(0, 3, GL_FLOAT, GL_TRUE, stride, (void*)0);
+				glEnableVertexAttribArray(0);
+				glVertexAttribPointer(1, 4, GL_FLOAT, GL_TRUE, stride, (void*)sizeof(Vector3));
+				glEnableVertexAttribArray(1);
+				glVertexAttribPointer(2, 4, GL_FLOAT, GL_TRUE, stride, (void*)(sizeof(Vector3) + sizeof(Color)));
+				glEnableVertexAttribArray(2);
+				glBindVertexArray(0);
+			}
+			else
+			{
+				glBindBuffer(GL_ARRAY_BUFFER, m_buffer);
+			}
+
+			if(m_vertices.size() > m_bufferCapacity)
+				m_bufferCapacity = Math::Max<size_t>(m_vertices.size(), Math::Max<size_t>(m_bufferCapacity * 2, 1024));
+
+			// Orphan last frame's storage so the driver doesn't have to wait for draws still reading from it
+			glBufferData(GL_ARRAY_BUFFER, m_bufferCapacity * sizeof(ParticleVertex), nullptr, GL_STREAM_DRAW);
+			glBufferSubData(GL_ARRAY_BUFFER, 0, m_vertices.size() * sizeof(ParticleVertex), m_vertices.data());
+			glBindBuffer(GL_ARRAY_BUFFER, 0);
+			return true;
 		}
 	};
 
@@ -79,67 +214,38 @@ namespace Graphics
 	}
 
 
-	// Particle instance class
-	class Particle
+	// Particle storage, one array per attribute so the simulation loops can be vectorized
+	struct ParticlePool
 	{
-	public:
-		float life = 0.0f;
-		float maxLife = 0.0f;
-		float rotation = 0.0f;
-		float startSize = 0.0f;
-		Color startColor;
-		Vector3 pos;
-		Vector3 velocity;
-		float scale;
-		float fade;
-		float drag;
-		
-
-		bool IsAlive() const
+		Vector<float> life;
+		Vector<float> maxLife;
+		Vector<float> rotation;
+		Vector<float> startSize;
+		Vector<float> drag;
+		Vector<float> scale;
+		Vector<float> fade;
+		Vector<float> posX, posY, posZ;
+		Vector<float> velX, velY, velZ;
+		Vector<Color> startColor;
+
+		void Resize(uint32 size)
 		{
-			return life > 0.0f;
+			for(Vector<float>* v : { &life, &maxLife, &rotation, &startSize, &drag, &scale, &fade, &posX, &posY, &posZ, &velX, &velY, &velZ })
+				v->resize(size);
+			startColor.resize(size);
 		}
-		inline void Init(ParticleEmitter* emitter)
+		// Moves the particle at src into the slot at dst
+		void Move(uint32 dst, uint32 src)
 		{
-			const float& et = emitter->m_emitterRate;
-			life = maxLife = emitter->m_param_Lifetime->Init(et);
-			pos = emitter->m_param_StartPosition->Init(et) * emitter->scale;
-
-			// Velocity of startvelocity and spawn offset scale
-			velocity = emitter->m_param_StartVelocity->Init(et) * emitter->scale;
-			float spawnVelScale = emitter->m_param_SpawnVelocityScale->Init(et);
-			if(spawnVelScale > 0)
-				velocity += pos.Normalized() * spawnVelScale  * emitter->scale;
-
-			// Add emitter offset to location
-			pos += emitter->position;
-
-			startColor = emitter->m_param_StartColor->Init(et);
-			rotation = emitter->m_param_StartRotation->Init(et);
-			startSize = emitter->m_param_StartSize->Init(et) * emitter->scale;
-			drag = emitter->m_param_StartDrag->Init(et);
-		}
-		inline void Simulate(ParticleEmitter* emitter, float deltaTime)
-		{
-			float c = 1 - life / maxLife;
-
-			// Add gravity
-			velocity += emitter->m_param_Gravity->Sample(emitter->m_emitterTime) * deltaTime * emitter->scale;
-			pos += velocity * deltaTime;
-
-			// Add drag
-			velocity += -velocity * deltaTime * drag;
-
-			fade = emitter->m_param_FadeOverTime->Sample(c);
-			scale = emitter->m_param_ScaleOverTime->Sample(c);
-			life -= deltaTime;
+			for(Vector<float>* v : { &life, &maxLife, &rotation, &startSize, &drag, &scale, &fade, &posX, &posY, &posZ, &velX, &velY, &velZ })
+				(*v)[dst] = (*v)[src];
+			startColor[dst] = startColor[src];
 		}
 	};
 
 	ParticleEmitter::ParticleEmitter(ParticleSystem_Impl* sys) : m_system(sys)
 	{
-		m_mesh = MeshRes::Create(m_system->gl);
-		m_mesh->SetPrimitiveType(PrimitiveType::PointList);
+		m_pool = new ParticlePool();
 
 		// Set parameter defaults
 #define PARTICLE_DEFAULT(__name, __value)\
@@ -154,46 +260,72 @@ namespace Graphics
 		delete m_param_##__name; m_param_##__name = nullptr; }
 #include "ParticleParameters.hpp"
 
-		if(m_particles)
-		{
-			delete[] m_particles;
-		}
+		delete m_pool;
 	}
 
 	void ParticleEmitter::m_ReallocatePool(uint32 newCapacity)
 	{
-		Particle* oldParticles = m_particles;
-		uint32 oldSize = m_poolSize;
-
-		// Create new pool
+		m_pool->Resize(newCapacity);
 		m_poolSize = newCapacity;
-		if(newCapacity > 0)
+		m_numParticles = Math::Min(m_numParticles, m_poolSize);
+	}
+	void ParticleEmitter::m_Integrate(uint32 begin, uint32 end, float deltaTime)
+	{
+		ParticlePool& pool = *m_pool;
+		const Vector3 gravity = m_param_Gravity->Sample(m_emitterTime) * deltaTime * scale;
+
+		// Add gravity and drag, kept free of calls and branches so the compiler can vectorize it
+		float* velX = pool.velX.data();
+		float* velY = pool.velY.data();
+		float* velZ = pool.velZ.data();
+		float* posX = pool.posX.data();
+		float* posY = pool.posY.data();
+		float* posZ = pool.posZ.data();
+		const float* drag = pool.drag.data();
+		for(uint32 i = begin; i < end; i++)
 		{
-			m_particles = new Particle[m_poolSize];
-			for (size_t i = 0; i < m_poolSize; i++)
-			{
-				m_particles[i] = Particle();
-			}
-			
+			float vx = velX[i] + gravity.x;
+			float vy = velY[i] + gravity.y;
+			float vz = velZ[i] + gravity.z;
+			posX[i] += vx * deltaTime;
+			posY[i] += vy * deltaTime;
+			posZ[i] += vz * deltaTime;
+			float dragFactor = 1.0f - deltaTime * drag[i];
+			velX[i] = vx * dragFactor;
+			velY[i] = vy * dragFactor;
+			velZ[i] = vz * dragFactor;
 		}
-		else
+
+		// Curves are sampled at the life fraction before this step
+		for(uint32 i = begin; i < end; i++)
 		{
-			m_particles = nullptr;
+			float c = 1 - pool.life[i] / pool.maxLife[i];
+			pool.fade[i] = m_param_FadeOverTime->Sample(c);
+			pool.scale[i] = m_param_ScaleOverTime->Sample(c);
 		}
 
-		if(oldParticles && m_particles)
+		float* life = pool.life.data();
+		for(uint32 i = begin; i < end; i++)
 		{
-			memcpy(m_particles, oldParticles, Math::Min(oldSize, m_poolSize) * sizeof(Particle));
+			life[i] -= deltaTime;
 		}
-
-		if(oldParticles)
-			delete[] oldParticles;
 	}
-	void ParticleEmitter::Render(const class RenderState& rs, float deltaTime)
+	void ParticleEmitter::Simulate(float deltaTime)
 	{
 		if(m_finished)
 			return;
 
+		// Particles that died during the last frame have been drawn, remove them now by moving the last particle into their slot
+		for(uint32 i = 0; i < m_numParticles;)
+		{
+			if(m_pool->life[i] <= 0.0f)
+			{
+				m_pool->Move(i, --m_numParticles);
+				continue;
+			}
+			i++;
+		}
+
 		uint32 maxDuration = (uint32)ceilf(m_param_Lifetime->GetMax());
 		uint32 maxSpawns = (uint32)ceilf(m_param_SpawnRate->GetMax());
 		uint32 maxParticles = maxSpawns * maxDuration;
@@ -203,9 +335,6 @@ namespace Graphics
 		if(maxParticles > m_poolSize)
 			m_ReallocatePool(maxParticles);
 
-		// Resulting vertex bufffer
-		Vector<ParticleVertex> verts;
-
 		// Increment emitter time
 		m_emitterTime += deltaTime;
 		while(m_emitterTime > duration)
@@ -233,77 +362,70 @@ namespace Graphics
 			spawnTimeOffsetStep = deltaTime / spawnsf;
 		}
 
-		bool updatedSomething = false;
-		for(uint32 i = 0; i < m_poolSize; i++)
+		// Update existing particles
+		bool updatedSomething = m_numParticles > 0;
+		m_Integrate(0, m_numParticles, deltaTime);
+
+		// Spawn new particles after the live ones
+		ParticlePool& pool = *m_pool;
+		numSpawns = Math::Min(numSpawns, m_poolSize - m_numParticles);
+		for(; numSpawns > 0; numSpawns--)
 		{
-			Particle& p = m_particles[i];
+			uint32 i = m_numParticles++;
+			const float& et = m_emitterRate;
+			pool.life[i] = pool.maxLife[i] = m_param_Lifetime->Init(et);
+			Vector3 pos = m_param_StartPosition->Init(et) * scale;
 
-			bool render = false;
-			if(!m_particles[i].IsAlive())
-			{
-				// Try to spawn a new particle in this slot
-				if(numSpawns > 0)
-				{
-					p.Init(this);
-					p.Simulate(this, spawnTimeOffset);
-					spawnTimeOffset += spawnTimeOffsetStep;
-					numSpawns--;
-					render = true;
-				}
-			}
-			else
-			{
-				p.Simulate(this, deltaTime);
-				render = true;
-				updatedSomething = true;
-			}
+			// Velocity of startvelocity and spawn offset scale
+			Vector3 velocity = m_param_StartVelocity->Init(et) * scale;
+			float spawnVelScale = m_param_SpawnVelocityScale->Init(et);
+			if(spawnVelScale > 0)
+				velocity += pos.Normalized() * spawnVelScale * scale;
 
-			if(render)
-			{
-				verts.Add({ p.pos, p.startColor.WithAlpha(p.fade), Vector4(p.startSize * p.scale, p.rotation, 0, 0) });
-			}
+			// Add emitter offset to location
+			pos += position;
+
+			pool.posX[i] = pos.x;
+			pool.posY[i] = pos.y;
+			pool.posZ[i] = pos.z;
+			pool.velX[i] = velocity.x;
+			pool.velY[i] = velocity.y;
+			pool.velZ[i] = velocity.z;
+			pool.startColor[i] = m_param_StartColor->Init(et);
+			pool.rotation[i] = m_param_StartRotation->Init(et);
+			pool.startSize[i] = m_param_StartSize->Init(et) * scale;
+			pool.drag[i] = m_param_StartDrag->Init(et);
+
+			m_Integrate(i, i + 1, spawnTimeOffset);
+			spawnTimeOffset += spawnTimeOffsetStep;
 		}
 
 		if(m_deactivated)
 		{
 			m_finished = !updatedSomething;
 		}
-
-		MaterialParameterSet params;
-		if(texture)
-		{
-			params.SetParameter("mainTex", texture);
-		}
-		material->Bind(rs, params);
-
-		// Select blending mode based on material
-		switch(material->blendMode)
+	}
+	void ParticleEmitter::GenerateVertices(Vector<ParticleVertex>& out) const
+	{
+		const ParticlePool& pool = *m_pool;
+		out.reserve(out.size() + m_numParticles);
+		for(uint32 i = 0; i < m_numParticles; i++)
 		{
-		case MaterialBlendMode::Normal:
-			glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
-			break;
-		case MaterialBlendMode::Additive:
-			glBlendFunc(GL_SRC_ALPHA, GL_ONE);
-			break;
-		case MaterialBlendMode::Multiply:
-			glBlendFunc(GL_SRC_ALPHA, GL_SRC_COLOR);
-			break;
+			out.Add({ Vector3(pool.posX[i], pool.posY[i], pool.posZ[i]), pool.startColor[i].WithAlpha(pool.fade[i]),
+				Vector4(pool.startSize[i] * pool.scale[i], pool.rotation[i], 0, 0) });
 		}
-
-		m_mesh->SetData(verts);	
-		m_mesh->Draw();
 	}
 
 	void ParticleEmitter::Reset()
 	{
 		m_deactivated = false;
 		m_finished = false;
-		delete[] m_particles;
-		m_particles = nullptr;
+		*m_pool = ParticlePool();
 		m_emitterLoopIndex = 0;
 		m_emitterTime = 0;
 		m_spawnCounter = 0;
 		m_poolSize = 0;
+		m_numParticles = 0;
 	}
 
 	void ParticleEmitter::Deactivate()
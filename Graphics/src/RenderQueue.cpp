@@ -1,29 +1,39 @@
 #include "stdafx.h"
 #include "RenderQueue.hpp"
 #include "OpenGL.hpp"
-using Utility::Cast;
 
 namespace Graphics
 {
-	RenderQueue::RenderQueue(OpenGL* ogl, const RenderState& rs)
+	RenderQueue::RenderQueue(OpenGL* ogl, const RenderState& rs, RenderQueueSortMode sortMode)
 	{
 		m_ogl = ogl;
 		m_renderState = rs;
+		m_sortMode = sortMode;
 	}
 	RenderQueue::RenderQueue(RenderQueue&& other)
 	{
 		m_ogl = other.m_ogl;
 		other.m_ogl = nullptr;
+		m_simpleDrawCalls = move(other.m_simpleDrawCalls);
+		m_pointDrawCalls = move(other.m_pointDrawCalls);
 		m_orderedCommands = move(other.m_orderedCommands);
 		m_renderState = other.m_renderState;
+		m_sortMode = other.m_sortMode;
+		m_currentLayer = other.m_currentLayer;
+		m_lastCommandUnordered = other.m_lastCommandUnordered;
 	}
 	RenderQueue& RenderQueue::operator=(RenderQueue&& other)
 	{
 		Clear();
 		m_ogl = other.m_ogl;
 		other.m_ogl = nullptr;
+		m_simpleDrawCalls = move(other.m_simpleDrawCalls);
+		m_pointDrawCalls = move(other.m_pointDrawCalls);
 		m_orderedCommands = move(other.m_orderedCommands);
 		m_renderState = other.m_renderState;
+		m_sortMode = other.m_sortMode;
+		m_currentLayer = other.m_currentLayer;
+		m_lastCommandUnordered = other.m_lastCommandUnordered;
 		return *this;
 	}
 	RenderQueue::~RenderQueue()
@@ -34,88 +44,108 @@ namespace Graphics
 	{
 		assert(m_ogl);
 
+		if(m_sortMode == RenderQueueSortMode::SortKey)
+		{
+			// Stable so commands with equal keys keep their submission order
+			std::stable_sort(m_orderedCommands.begin(), m_orderedCommands.end(), [](const Command& l, const Command& r)
+			{
+				return l.sortKey < r.sortKey;
+			});
+		}
+
+		RenderStats& stats = m_ogl->m_renderStats;
+
 		bool scissorEnabled = false;
 		bool blendEnabled = false;
 		MaterialBlendMode activeBlendMode = (MaterialBlendMode)-1;
 
-		Set<Material> initializedShaders;
+		// Materials that had their shared parameters bound during this call, usually only a handful
+		Vector<MaterialRes*> initializedShaders;
 		Mesh currentMesh;
 		Material currentMaterial;
 
-		// Create a new list of items
-		for(RenderQueueItem* item : m_orderedCommands)
+		auto SetupMaterial = [&](Material& mat, MaterialParameterSet& params)
 		{
-			auto SetupMaterial = [&](Material& mat, MaterialParameterSet& params)
+			bool changed = currentMaterial != mat;
+
+			// Only bind params if material is already bound to context
+			if(!changed)
+				mat->BindParameters(params, m_renderState.worldTransform);
+			else
 			{
-				// Only bind params if material is already bound to context
-				if(currentMaterial == mat)
+				if(std::find(initializedShaders.begin(), initializedShaders.end(), mat.get()) != initializedShaders.end())
+				{
+					// Only bind params and rebind
 					mat->BindParameters(params, m_renderState.worldTransform);
+					mat->BindToContext();
+					currentMaterial = mat;
+				}
 				else
 				{
-					if(initializedShaders.Contains(mat))
-					{
-						// Only bind params and rebind
-						mat->BindParameters(params, m_renderState.worldTransform);
-						mat->BindToContext();
-						currentMaterial = mat;
-					}
-					else
-					{
-						mat->Bind(m_renderState, params);
-						initializedShaders.Add(mat);
-						currentMaterial = mat;
-					}
+					mat->Bind(m_renderState, params);
+					initializedShaders.push_back(mat.get());
+					currentMaterial = mat;
 				}
+				stats.materialChanges++;
+			}
 
-				// Setup Render state for transparent object
-				if(mat->opaque)
+			// Setup Render state for transparent object
+			if(mat->opaque)
+			{
+				if(blendEnabled)
 				{
-					if(blendEnabled)
-					{
-						glDisable(GL_BLEND);
-						blendEnabled = false;
-					}
+					glDisable(GL_BLEND);
+					blendEnabled = false;
 				}
-				else
+			}
+			else
+			{
+				if(!blendEnabled)
 				{
-					if(!blendEnabled)
-					{
-						glEnable(GL_BLEND);
-						blendEnabled = true;
-					}
-					if(activeBlendMode != mat->blendMode)
+					glEnable(GL_BLEND);
+					blendEnabled = true;
+				}
+				if(activeBlendMode != mat->blendMode)
+				{
+					switch(mat->blendMode)
 					{
-						switch(mat->blendMode)
-						{
-						case MaterialBlendMode::Normal:
-							glBlendFuncSeparate(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA, GL_ONE, GL_ONE);
-							break;
-						case MaterialBlendMode::Additive:
-							glBlendFunc(GL_ONE, GL_ONE);
-							break;
-						case MaterialBlendMode::Multiply:
-							glBlendFunc(GL_SRC_ALPHA, GL_SRC_COLOR);
-							break;
-						}
+					case MaterialBlendMode::Normal:
+						glBlendFuncSeparate(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA, GL_ONE, GL_ONE);
+						break;
+					case MaterialBlendMode::Additive:
+						glBlendFunc(GL_ONE, GL_ONE);
+						break;
+					case MaterialBlendMode::Multiply:
+						glBlendFunc(GL_SRC_ALPHA, GL_SRC_COLOR);
+						break;
 					}
+					activeBlendMode = mat->blendMode;
+					stats.blendChanges++;
 				}
-			};
+			}
+		};
 
-			// Draw mesh helper
-			auto DrawOrRedrawMesh = [&](Mesh& mesh)
+		// Draw mesh helper
+		auto DrawOrRedrawMesh = [&](Mesh& mesh)
+		{
+			if(currentMesh == mesh)
 			{
-				if(currentMesh == mesh)
-					mesh->Redraw();
-				else
-				{
-					mesh->Draw();
-					currentMesh = mesh;
-				}
-			};
+				mesh->Redraw();
+			}
+			else
+			{
+				mesh->Draw();
+				currentMesh = mesh;
+				stats.meshChanges++;
+			}
+			stats.drawCalls++;
+		};
 
-			if(Cast<SimpleDrawCall>(item))
+		for(const Command& command : m_orderedCommands)
+		{
+			if(!command.isPointDraw)
 			{
-				SimpleDrawCall* sdc = (SimpleDrawCall*)item;
+				SimpleDrawCall* sdc = &m_simpleDrawCalls[command.index];
 				m_renderState.worldTransform = sdc->worldTransform;
 				SetupMaterial(sdc->mat, sdc->params);
 
@@ -147,7 +177,7 @@ namespace Graphics
 				glUseProgram(0);
 				#endif
 			}
-			else if(Cast<PointDrawCall>(item))
+			else
 			{
 				if(scissorEnabled)
 				{
@@ -156,7 +186,7 @@ namespace Graphics
 					scissorEnabled = false;
 				}
 
-				PointDrawCall* pdc = (PointDrawCall*)item;
+				PointDrawCall* pdc = &m_pointDrawCalls[command.index];
 				m_renderState.worldTransform = Transform();
 				SetupMaterial(pdc->mat, pdc->params);
 				PrimitiveType pt = pdc->mesh->GetPrimitiveType();
@@ -190,67 +220,119 @@ namespace Graphics
 
 	void RenderQueue::Clear()
 	{
-		// Cleanup the list of items
-		for(RenderQueueItem* item : m_orderedCommands)
-		{
-			delete item;
-		}
+		// Keeps the storage of the arenas around for the next batch of commands
+		m_simpleDrawCalls.clear();
+		m_pointDrawCalls.clear();
 		m_orderedCommands.clear();
+		m_currentLayer = 0;
+		m_lastCommandUnordered = false;
 	}
 
 	void RenderQueue::Draw(Transform worldTransform, Mesh m, Material mat, const MaterialParameterSet& params)
 	{
-		SimpleDrawCall* sdc = new SimpleDrawCall();
-		sdc->mat = mat;
-		sdc->mesh = m;
-		sdc->params = params;
-		sdc->worldTransform = worldTransform;
-		m_orderedCommands.push_back(sdc);
+		SimpleDrawCall& sdc = m_AddSimpleDrawCall();
+		sdc.mat = mat;
+		sdc.mesh = m;
+		sdc.params = params;
+		sdc.worldTransform = worldTransform;
+		m_AddCommand((uint32)m_simpleDrawCalls.size() - 1, false, sdc.mesh, sdc.mat, sdc.params);
 	}
 	void RenderQueue::Draw(Transform worldTransform, Ref<class TextRes> text, Material mat, const MaterialParameterSet& params)
 	{
-		SimpleDrawCall* sdc = new SimpleDrawCall();
-		sdc->mat = mat;
-		sdc->mesh = text->GetMesh();
-		sdc->params = params;
+		SimpleDrawCall& sdc = m_AddSimpleDrawCall();
+		sdc.mat = mat;
+		sdc.mesh = text->GetMesh();
+		sdc.params = params;
 		// Set Font texture map
-		sdc->params.SetParameter("mainTex", text->GetTexture());
-		sdc->worldTransform = worldTransform;
-		m_orderedCommands.push_back(sdc);
+		sdc.params.SetParameter("mainTex", text->GetTexture());
+		sdc.worldTransform = worldTransform;
+		m_AddCommand((uint32)m_simpleDrawCalls.size() - 1, false, sdc.mesh, sdc.mat, sdc.params);
 	}
 
 	void RenderQueue::DrawScissored(Rect scissor, Transform worldTransform, Mesh m, Material mat, const MaterialParameterSet& params /*= MaterialParameterSet()*/)
 	{
-		SimpleDrawCall* sdc = new SimpleDrawCall();
-		sdc->mat = mat;
-		sdc->mesh = m;
-		sdc->params = params;
-		sdc->worldTransform = worldTransform;
-		sdc->scissorRect = scissor;
-		m_orderedCommands.push_back(sdc);
+		SimpleDrawCall& sdc = m_AddSimpleDrawCall();
+		sdc.mat = mat;
+		sdc.mesh = m;
+		sdc.params = params;
+		sdc.worldTransform = worldTransform;
+		sdc.scissorRect = scissor;
+		m_AddCommand((uint32)m_simpleDrawCalls.size() - 1, false, sdc.mesh, sdc.mat, sdc.params);
 	}
 	void RenderQueue::DrawScissored(Rect scissor, Transform worldTransform, Ref<class TextRes> text, Material mat, const MaterialParameterSet& params /*= MaterialParameterSet()*/)
 	{
-		SimpleDrawCall* sdc = new SimpleDrawCall();
-		sdc->mat = mat;
-		sdc->mesh = text->GetMesh();
-		sdc->params = params;
+		SimpleDrawCall& sdc = m_AddSimpleDrawCall();
+		sdc.mat = mat;
+		sdc.mesh = text->GetMesh();
+		sdc.params = params;
 		// Set Font texture map
-		sdc->params.SetParameter("mainTex", text->GetTexture());
-		sdc->params.SetParameter("mapSize", text->GetTexture()->GetSize());
-		sdc->worldTransform = worldTransform;
-		sdc->scissorRect = scissor;
-		m_orderedCommands.push_back(sdc);
+		sdc.params.SetParameter("mainTex", text->GetTexture());
+		sdc.params.SetParameter("mapSize", text->GetTexture()->GetSize());
+		sdc.worldTransform = worldTransform;
+		sdc.scissorRect = scissor;
+		m_AddCommand((uint32)m_simpleDrawCalls.size() - 1, false, sdc.mesh, sdc.mat, sdc.params);
 	}
 
 	void RenderQueue::DrawPoints(Mesh m, Material mat, const MaterialParameterSet& params, float pointSize)
 	{
-		PointDrawCall* pdc = new PointDrawCall();
-		pdc->mat = mat;
-		pdc->mesh = m;
-		pdc->params = params;
-		pdc->size = pointSize;
-		m_orderedCommands.push_back(pdc);
+		m_pointDrawCalls.emplace_back();
+		PointDrawCall& pdc = m_pointDrawCalls.back();
+		pdc.mat = mat;
+		pdc.mesh = m;
+		pdc.params = params;
+		pdc.size = pointSize;
+		m_AddCommand((uint32)m_pointDrawCalls.size() - 1, true, pdc.mesh, pdc.mat, pdc.params);
+	}
+
+	SimpleDrawCall& RenderQueue::m_AddSimpleDrawCall()
+	{
+		m_simpleDrawCalls.emplace_back();
+		return m_simpleDrawCalls.back();
+	}
+
+	void RenderQueue::m_AddCommand(uint32 index, bool isPointDraw, const Mesh& mesh, const Material& mat, const MaterialParameterSet& params)
+	{
+		Command command;
+		command.index = index;
+		command.isPointDraw = isPointDraw;
+		command.sortKey = 0;
+
+		if(m_sortMode == RenderQueueSortMode::SortKey)
+		{
+			// Additive blending gives the same result in any order, everything else has to stay in submission order
+			bool unordered = !mat->opaque && mat->blendMode == MaterialBlendMode::Additive;
+			if(!unordered || !m_lastCommandUnordered)
+				m_currentLayer++;
+			m_lastCommandUnordered = unordered;
+
+			// Only used to group identical state together, collisions just cost an extra state change
+			auto HashPointer = [](const void* ptr, uint32 bits)
+			{
+				uint64 v = (uint64)(size_t)ptr;
+				v ^= v >> 17;
+				v *= 0x9E3779B97F4A7C15ull;
+				return (v >> (64 - bits));
+			};
+
+			const void* texture = nullptr;
+			for(auto& param : params)
+			{
+				if(param.second.parameterType == GL_SAMPLER_2D)
+				{
+					texture = param.second.Get<Ref<TextureRes>>().get();
+					break;
+				}
+			}
+
+			// Layer (24) | Blend mode (2) | Material (14) | Texture (12) | Mesh (12)
+			command.sortKey = ((uint64)(m_currentLayer & 0xFFFFFF) << 40)
+				| ((uint64)((uint32)mat->blendMode & 0x3) << 38)
+				| (HashPointer(mat.get(), 14) << 24)
+				| (HashPointer(texture, 12) << 12)
+				| HashPointer(mesh.get(), 12);
+		}
+
+		m_orderedCommands.push_back(command);
 	}
 
 	// Initializes the simple draw call structure
@@ -0,0 +1,153 @@
+#include "stdafx.h"
+#include "ScreenCapture.hpp"
+#include "OpenGL.hpp"
+
+namespace Graphics
+{
+	ScreenCapture::ScreenCapture(OpenGL* gl, Vector2i size, Vector2i pos)
+		: m_gl(gl), m_size(size)
+	{
+		assert(m_gl->IsOpenGLThread());
+
+		if(size.x <= 0 || size.y <= 0)
+		{
+			m_done = true;
+			return;
+		}
+
+		GLenum err;
+		while((err = glGetError()) != GL_NO_ERROR) //Clear out preexisting errors
+		{
+			Logf("OpenGL Error: 0x%p", Logger::Severity::Debug, err);
+		}
+
+		glBindFramebuffer(GL_READ_FRAMEBUFFER, 0);
+		glReadBuffer(GL_BACK);
+
+#ifdef EMBEDDED
+		// No pixel buffer objects on GLES2, read back directly
+		m_image = ImageRes::Create(size);
+		glReadPixels(pos.x, pos.y, size.x, size.y, GL_RGBA, GL_UNSIGNED_BYTE, m_image->GetBits());
+		m_done = true;
+#else
+		size_t bytes = (size_t)size.x * size.y * sizeof(Colori);
+		glGenBuffers(1, &m_pixelBuffer);
+		glBindBuffer(GL_PIXEL_PACK_BUFFER, m_pixelBuffer);
+		glBufferData(GL_PIXEL_PACK_BUFFER, bytes, nullptr, GL_STREAM_READ);
+		// Copied into the pixel buffer asynchronously
+		glReadPixels(pos.x, pos.y, size.x, size.y, GL_RGBA, GL_UNSIGNED_BYTE, nullptr);
+		glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+		m_fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+#endif
+
+		while((err = glGetError()) != GL_NO_ERROR)
+		{
+			Logf("OpenGL Error: 0x%p", Logger::Severity::Error, err);
+			m_Release();
+			m_done = true;
+			m_image.reset();
+		}
+	}
+	ScreenCapture::~ScreenCapture()
+	{
+		m_Release();
+	}
+
+	bool ScreenCapture::Poll()
+	{
+		if(m_done)
+			return true;
+
+#ifndef EMBEDDED
+		// Flush so the fence is guaranteed to signal eventually, but never wait on it
+		GLenum status = glClientWaitSync((GLsync)m_fence, GL_SYNC_FLUSH_COMMANDS_BIT, 0);
+		if(status == GL_TIMEOUT_EXPIRED)
+			return false;
+
+		if(status != GL_WAIT_FAILED)
+		{
+			size_t bytes = (size_t)m_size.x * m_size.y * sizeof(Colori);
+			glBindBuffer(GL_PIXEL_PACK_BUFFER, m_pixelBuffer);
+			void* src = glMapBufferRange(GL_PIXEL_PACK_BUFFER, 0, bytes, GL_MAP_READ_BIT);
+			if(src)
+			{
+				m_image = ImageRes::Create(m_size);
+				memcpy(m_image->GetBits(), src, bytes);
+				glUnmapBuffer(GL_PIXEL_PACK_BUFFER);
+			}
+			glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+		}
+		else
+		{
+			Log("Waiting for screen capture failed", Logger::Severity::Error);
+		}
+
+		m_Release();
+#endif
+		m_done = true;
+		return true;
+	}
+
+	void ScreenCapture::m_Release()
+	{
+#ifndef EMBEDDED
+		if(m_fence)
+		{
+			glDeleteSync((GLsync)m_fence);
+			m_fence = nullptr;
+		}
+		if(m_pixelBuffer)
+		{
+			glDeleteBuffers(1, &m_pixelBuffer);
+			m_pixelBuffer = 0;
+		}
+#endif
+	}
+
+	ScreenshotSaver::ScreenshotSaver(OpenGL* gl, JobSheduler* sheduler, const String& path, Vector2i size, Vector2i pos, int32 compressionLevel)
+		: m_sheduler(sheduler), m_path(path), m_compressionLevel(compressionLevel)
+	{
+		m_capture = Ref<ScreenCapture>(new ScreenCapture(gl, size, pos));
+	}
+	ScreenshotSaver::~ScreenshotSaver()
+	{
+		// A pending save keeps running, it only needs to stop reporting back here
+		if(m_job)
+			m_job->OnFinished.RemoveAll(this);
+	}
+
+	void ScreenshotSaver::Update()
+	{
+		if(!m_capture || !m_capture->Poll())
+			return;
+
+		Ref<ImageRes> image = m_capture->GetImage();
+		m_capture.reset();
+		if(!image)
+		{
+			m_Finish("Failed to capture screenshot");
+			return;
+		}
+
+		// Encode and write the file in the background
+		String path = m_path;
+		int32 compressionLevel = m_compressionLevel;
+		m_job = JobBase::CreateLambda([image, path, compressionLevel]() {
+			image->SavePNG(path, compressionLevel);
+			return true;
+		});
+		m_job->OnFinished.Add(this, &ScreenshotSaver::m_OnJobFinished);
+		m_sheduler->Queue(m_job);
+	}
+
+	void ScreenshotSaver::m_OnJobFinished(Job& job)
+	{
+		m_job.reset();
+		m_Finish(m_path);
+	}
+	void ScreenshotSaver::m_Finish(const String& result)
+	{
+		m_done = true;
+		OnSaved.Call(result);
+	}
+}
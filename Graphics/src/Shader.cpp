@@ -24,6 +24,129 @@ namespace Graphics
 		GL_FRAGMENT_SHADER_BIT,
 		GL_GEOMETRY_SHADER_BIT,
 	};
+
+	/*
+		Linked programs are cached on disk with glGetProgramBinary
+		Entries are keyed by the driver and the final shader source, so a driver update or changed source simply misses the cache
+	*/
+	static const uint32 programCacheMagic = 0x42505355; // "USPB"
+	static bool programCacheChecked = false;
+	static bool programCacheSupported = false;
+	static String programCacheDriver;
+
+	static bool IsProgramCacheSupported()
+	{
+		if(programCacheChecked)
+			return programCacheSupported;
+		programCacheChecked = true;
+
+		GLint numFormats = 0;
+		glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS, &numFormats);
+		// Not an error when the driver doesn't know about program binaries
+		while(glGetError() != GL_NO_ERROR)
+			;
+		if(numFormats <= 0)
+		{
+			Log("Driver does not support program binaries, shaders will not be cached", Logger::Severity::Info);
+			return false;
+		}
+
+		programCacheDriver = Utility::Sprintf("%s;%s;%s", glGetString(GL_VENDOR), glGetString(GL_RENDERER), glGetString(GL_VERSION));
+		programCacheSupported = Path::CreateDir(Path::Absolute("shadercache")) || Path::IsDirectory(Path::Absolute("shadercache"));
+		return programCacheSupported;
+	}
+	static String GetProgramCachePath(ShaderType type, const String& source)
+	{
+		// FNV-1a over the driver, shader type and source
+		uint64 hash = 14695981039346656037ULL;
+		auto add = [&](const void* data, size_t len)
+		{
+			for(size_t i = 0; i < len; i++)
+			{
+				hash ^= ((const uint8*)data)[i];
+				hash *= 1099511628211ULL;
+			}
+		};
+		add(*programCacheDriver, programCacheDriver.size());
+		add(&type, sizeof(type));
+		add(*source, source.size());
+		return Path::Absolute(Utility::Sprintf("shadercache/%016llx.bin", (unsigned long long)hash));
+	}
+	static uint32 LoadCachedProgram(const String& path)
+	{
+		File in;
+		if(!in.OpenRead(path))
+			return 0;
+
+		uint32 header[2]; // Magic, binary format
+		if(in.GetSize() <= sizeof(header) || in.Read(header, sizeof(header)) != sizeof(header) || header[0] != programCacheMagic)
+			return 0;
+		Vector<uint8> binary(in.GetSize() - sizeof(header));
+		if(in.Read(binary.data(), binary.size()) != binary.size())
+			return 0;
+
+		uint32 program = glCreateProgram();
+		glProgramParameteri(program, GL_PROGRAM_SEPARABLE, GL_TRUE);
+		glProgramBinary(program, header[1], binary.data(), (GLsizei)binary.size());
+		int nStatus = 0;
+		glGetProgramiv(program, GL_LINK_STATUS, &nStatus);
+		if(nStatus == 0)
+		{
+			// Rejected by the driver, gets replaced after compiling from source
+			glDeleteProgram(program);
+			return 0;
+		}
+		return program;
+	}
+	static void SaveCachedProgram(const String& path, uint32 program)
+	{
+		GLint length = 0;
+		glGetProgramiv(program, GL_PROGRAM_BINARY_LENGTH, &length);
+		if(length <= 0)
+			return;
+
+		Vector<uint8> binary(length);
+		GLenum format = 0;
+		glGetProgramBinary(program, length, &length, &format, binary.data());
+
+		File out;
+		if(!out.OpenWrite(path))
+			return;
+		uint32 header[2] = { programCacheMagic, format };
+		out.Write(header, sizeof(header));
+		out.Write(binary.data(), length);
+	}
+	// Same as glCreateShaderProgramv, but allows retrieving the program binary afterwards
+	static uint32 CreateRetrievableProgram(ShaderType type, const char* source, const String& sourcePath)
+	{
+		uint32 shader = glCreateShader(typeMap[(size_t)type]);
+		if(shader == 0)
+			return 0;
+		glShaderSource(shader, 1, &source, nullptr);
+		glCompileShader(shader);
+
+		int nStatus = 0;
+		glGetShaderiv(shader, GL_COMPILE_STATUS, &nStatus);
+		if(nStatus == GL_FALSE)
+		{
+			static char infoLogBuffer[2048];
+			int s = 0;
+			glGetShaderInfoLog(shader, sizeof(infoLogBuffer), &s, infoLogBuffer);
+
+			Logf("Shader program compile log for %s: %s", Logger::Severity::Error, sourcePath, infoLogBuffer);
+			glDeleteShader(shader);
+			return 0;
+		}
+
+		uint32 program = glCreateProgram();
+		glProgramParameteri(program, GL_PROGRAM_SEPARABLE, GL_TRUE);
+		glProgramParameteri(program, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
+		glAttachShader(program, shader);
+		glLinkProgram(program);
+		glDetachShader(program, shader);
+		glDeleteShader(shader);
+		return program;
+	}
 #endif
 	class Shader_Impl : public ShaderRes
 	{
@@ -135,20 +258,41 @@ namespace Graphics
 				sourceStr = "#version 330\n" + sourceStr;
 			}
 			const char* pChars = *sourceStr;
-			programOut = glCreateShaderProgramv(typeMap[(size_t)m_type], 1, &pChars);
-			if(programOut == 0)
-				return false;
+			bool useCache = IsProgramCacheSupported();
+			String cachePath;
+			if(useCache)
+			{
+				cachePath = GetProgramCachePath(m_type, sourceStr);
+				programOut = LoadCachedProgram(cachePath);
+			}
+			else
+			{
+				programOut = 0;
+			}
 
-			int nStatus = 0;
-			glGetProgramiv(programOut, GL_LINK_STATUS, &nStatus);
-			if(nStatus == 0)
+			if(programOut == 0)
 			{
-				static char infoLogBuffer[2048];
-				int s = 0;
-				glGetProgramInfoLog(programOut, sizeof(infoLogBuffer), &s, infoLogBuffer);
+				if(useCache)
+					programOut = CreateRetrievableProgram(m_type, pChars, m_sourcePath);
+				else
+					programOut = glCreateShaderProgramv(typeMap[(size_t)m_type], 1, &pChars);
+				if(programOut == 0)
+					return false;
 
-				Logf("Shader program compile log for %s: %s", Logger::Severity::Error, m_sourcePath, infoLogBuffer);
-				return false;
+				int nStatus = 0;
+				glGetProgramiv(programOut, GL_LINK_STATUS, &nStatus);
+				if(nStatus == 0)
+				{
+					static char infoLogBuffer[2048];
+					int s = 0;
+					glGetProgramInfoLog(programOut, sizeof(infoLogBuffer), &s, infoLogBuffer);
+
+					Logf("Shader program compile log for %s: %s", Logger::Severity::Error, m_sourcePath, infoLogBuffer);
+					return false;
+				}
+
+				if(useCache)
+					SaveCachedProgram(cachePath, programOut);
 			}
 
 			// Shader hot-reload in debug mode
@@ -95,6 +95,14 @@ namespace Graphics
 			UpdateFilterState();
 			UpdateWrap();
 		}
+		void SetSubData(Vector2i pos, Vector2i size, const void* pData) override
+		{
+			assert(m_format == TextureFormat::RGBA8);
+			assert(pos.x >= 0 && pos.y >= 0 && pos.x + size.x <= m_size.x && pos.y + size.y <= m_size.y);
+			glBindTexture(GL_TEXTURE_2D, m_texture);
+			glTexSubImage2D(GL_TEXTURE_2D, 0, pos.x, pos.y, size.x, size.y, GL_RGBA, GL_UNSIGNED_BYTE, pData);
+			glBindTexture(GL_TEXTURE_2D, 0);
+		}
 		void UpdateFilterState()
 		{
 			glBindTexture(GL_TEXTURE_2D, m_texture);
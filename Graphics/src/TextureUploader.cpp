@@ -0,0 +1,79 @@
+#include "stdafx.h"
+#include "TextureUploader.hpp"
+#include "OpenGL.hpp"
+
+namespace Graphics
+{
+	TextureUploader::TextureUploader(OpenGL* gl, size_t frameBudget)
+		: m_gl(gl), m_frameBudget(frameBudget)
+	{
+	}
+	TextureUploader::~TextureUploader()
+	{
+		if(m_pixelBuffer)
+			glDeleteBuffers(1, &m_pixelBuffer);
+	}
+
+	void TextureUploader::NewFrame()
+	{
+		m_frameBytes = 0;
+		m_frameUploads = 0;
+	}
+	bool TextureUploader::HasBudget(size_t bytes) const
+	{
+		return m_frameUploads == 0 || m_frameBytes + bytes <= m_frameBudget;
+	}
+
+	void TextureUploader::Upload(uint32 textureHandle, const Ref<ImageRes>& image)
+	{
+		assert(m_gl->IsOpenGLThread());
+
+		Vector2i size = image->GetSize();
+		size_t bytes = (size_t)size.x * size.y * sizeof(Colori);
+
+		glBindTexture(GL_TEXTURE_2D, textureHandle);
+#ifdef EMBEDDED
+		// No pixel buffer objects on GLES2
+		glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, size.x, size.y, GL_RGBA, GL_UNSIGNED_BYTE, image->GetBits());
+#else
+		if(!m_pixelBuffer)
+			glGenBuffers(1, &m_pixelBuffer);
+
+		glBindBuffer(GL_PIXEL_UNPACK_BUFFER, m_pixelBuffer);
+		// Orphan the previous storage so this doesn't wait for the last upload to complete
+		glBufferData(GL_PIXEL_UNPACK_BUFFER, bytes, nullptr, GL_STREAM_DRAW);
+		void* dst = glMapBufferRange(GL_PIXEL_UNPACK_BUFFER, 0, bytes, GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_BUFFER_BIT);
+		if(dst)
+		{
+			memcpy(dst, image->GetBits(), bytes);
+			glUnmapBuffer(GL_PIXEL_UNPACK_BUFFER);
+			// Copied from the pixel buffer asynchronously
+			glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, size.x, size.y, GL_RGBA, GL_UNSIGNED_BYTE, nullptr);
+			glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+		}
+		else
+		{
+			glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+			glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, size.x, size.y, GL_RGBA, GL_UNSIGNED_BYTE, image->GetBits());
+		}
+#endif
+		glBindTexture(GL_TEXTURE_2D, 0);
+
+		m_frameBytes += bytes;
+		m_frameUploads++;
+		m_gl->m_renderStats.textureUploadBytes += (uint32)bytes;
+	}
+	void TextureUploader::UploadCompressed(uint32 textureHandle, Vector2i size, uint32 format, const Buffer& data)
+	{
+		assert(m_gl->IsOpenGLThread());
+
+		// Compressed data is small enough to not be worth staging
+		glBindTexture(GL_TEXTURE_2D, textureHandle);
+		glCompressedTexImage2D(GL_TEXTURE_2D, 0, format, size.x, size.y, 0, (int32)data.size(), data.data());
+		glBindTexture(GL_TEXTURE_2D, 0);
+
+		m_frameBytes += data.size();
+		m_frameUploads++;
+		m_gl->m_renderStats.textureUploadBytes += (uint32)data.size();
+	}
+}
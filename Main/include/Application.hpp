@@ -3,6 +3,7 @@
 #include <Shared/Jobs.hpp>
 #include <Shared/Thread.hpp>
 #include "SkinHttp.hpp"
+#include "JacketCache.hpp"
 
 #define PLAYBACK
 
@@ -46,6 +47,9 @@ public:
 		int texture;
 		bool loaded = false;
 		Job loadingJob;
+		// Decoded or cached image waiting for its texture upload
+		Image pendingImage;
+		JacketCache::Entry pendingCompressed;
 	};
 	void ApplySettings();
 	// Runs the application
@@ -85,9 +89,14 @@ public:
 	Sample LoadSample(const String& name, const bool& external = false);
 	Graphics::Font LoadFont(const String& name, const bool& external = false);
 	int LoadImageJob(const String& path, Vector2i size, int placeholder, const bool& web = false);
+	// Queues a decoded jacket for upload, uploads are spread over multiple frames
+	void QueueJacketUpload(CachedJacketImage* image);
 	void SetScriptPath(lua_State* L);
 	lua_State* LoadScript(const String& name, bool noError = false);
 	void ReloadScript(const String& name, lua_State* L);
+	// Runs a script file like luaL_dofile, the compiled chunk is reused while the file content stays the same
+	// returns false and leaves the error message on the stack on failure
+	bool DoScriptFile(lua_State* L, const String& path);
 	void ShowLuaError(const String& error);
 	void LoadGauge(bool hard);
 	void DrawGauge(float rate, float x, float y, float w, float h, float deltaTime);
@@ -106,6 +115,22 @@ public:
 	int IsNamedSamplePlaying(String name);
 	void ReloadSkin();
 	void DisposeLua(lua_State* state);
+	// Replaces the automatic garbage collection of a lua state with incremental steps at the end of every frame
+	// States created by LoadScript are registered already, they are unregistered by DisposeLua
+	void RegisterLuaGC(lua_State* state);
+	// Runs a full garbage collection on all registered lua states, only used while a transition hides the hitch
+	void CollectLuaGarbage();
+	struct LuaGCStats
+	{
+		// Milliseconds spent on garbage collection steps in the last frame
+		float lastFrameTime = 0.0f;
+		// Longest frame of garbage collection steps in the last second
+		float maxFrameTime = 0.0f;
+		// Milliseconds spent by the last full collection
+		float lastFullCollectTime = 0.0f;
+		uint32 cyclesCompleted = 0;
+	};
+	const LuaGCStats& GetLuaGCStats() const;
 	void SetGaugeColor(int i, Color c);
 	void DiscordError(int errorCode, const char* message);
 	void DiscordPresenceMenu(String name);
@@ -137,6 +162,9 @@ private:
 	void m_OnWindowResized(const Vector2i& newSize);
 	void m_OnFocusChanged(bool focused);
 	void m_unpackSkins();
+	void m_UploadPendingJackets();
+	void m_StepLuaGC();
+	void m_UnregisterLuaGC(lua_State* state);
 
 	RenderState m_renderStateBase;
 	RenderQueue m_renderQueueBase;
@@ -148,6 +176,29 @@ private:
 	Material m_guiTex;
 	class HealthGauge* m_gauge;
 	Map<String, CachedJacketImage*> m_jacketImages;
+	// Compiled script chunks by file path, with a hash of the source they were compiled from
+	struct CachedScript
+	{
+		uint64 sourceHash;
+		String bytecode;
+	};
+	Map<String, CachedScript> m_scriptCache;
+	struct LuaGCState
+	{
+		lua_State* L;
+		// Memory usage at which the next collection cycle starts
+		size_t threshold;
+		// Memory usage after the last frame's steps, what was allocated since then is owed to the collector
+		size_t lastMemory;
+		bool collecting = false;
+	};
+	Vector<LuaGCState> m_luaGCStates;
+	size_t m_nextLuaGCState = 0;
+	LuaGCStats m_luaGCStats;
+	float m_luaGCMaxFrameTime = 0.0f;
+	Timer m_luaGCStatsTimer;
+	List<CachedJacketImage*> m_pendingJacketUploads;
+	TextureUploader* m_textureUploader = nullptr;
 	String m_lastMapPath;
 	Thread m_updateThread;
 	class Beatmap* m_currentMap = nullptr;
@@ -182,6 +233,7 @@ public:
 	virtual void Finalize();
 
 	Image loadedImage;
+	JacketCache::Entry compressedImage;
 	String imagePath;
 	int w = 0, h = 0;
 	bool web = false;
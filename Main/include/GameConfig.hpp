@@ -57,6 +57,9 @@ DefineEnum(GameConfigKeys,
 		   DistantButtonScale,
 		   BTOverFXScale,
 		   DisableBackgrounds,
+		   AnimationMemoryBudget, // MB of skin animation frames kept on the GPU
+		   JacketCacheSize, // MB of compressed jackets kept on disk
+		   LuaGCBudget, // Microseconds per frame spent collecting lua garbage
 		   ScoreDisplayMode,
 		   AutoComputeSongOffset,
 
@@ -147,6 +150,7 @@ DefineEnum(GameConfigKeys,
 		   EditorParamsFormat,
 
 		   AutoScoreScreenshot,
+		   ScreenshotCompressionLevel, // zlib level 0-9 used for screenshot PNGs, lower is faster
 
 		   WASAPI_Exclusive,
 		   MuteUnfocused,
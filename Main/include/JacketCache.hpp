@@ -0,0 +1,42 @@
+#pragma once
+#include "stdafx.h"
+
+/*
+	Persistent cache of downscaled song jackets
+	Jackets are stored as BC1 (DXT1) compressed blocks, keyed by their source path, modification time and target size,
+	so loading a cached jacket is a single small file read without any image decoding or rescaling
+*/
+class JacketCache
+{
+public:
+	struct Entry
+	{
+		Vector2i size;
+		// BC1 blocks covering the whole image, rows of 4x4 pixel blocks
+		Buffer blocks;
+	};
+
+	// Enables the cache if compressed textures are supported, call after the OpenGL context is created
+	// Entries of changed or removed images, and the oldest entries over maxSize bytes, are removed in the background
+	static void Init(size_t maxSize);
+	static bool IsEnabled();
+
+	// Loads a cached jacket, fails if there is none or the source image has changed
+	static bool Load(const String& imagePath, Vector2i targetSize, Entry& out);
+	// Compresses an image and stores it in the cache, fails for images that contain transparency
+	static bool Store(const String& imagePath, Vector2i targetSize, const Image& image, Entry& out);
+
+	// Size of the compressed data for an image of this size
+	static size_t GetCompressedSize(Vector2i size);
+	// OpenGL internal format of the compressed blocks
+	static uint32 GetTextureFormat();
+
+private:
+	static String m_GetCachePath(const String& imagePath, Vector2i targetSize);
+	// Reads the header of a cache file, returns false if the source image has changed since it was stored
+	static bool m_IsEntryValid(const String& cachePath);
+	static void m_Prune(size_t maxSize);
+	static void m_CompressBlock(const Colori* pixels, uint8* out);
+
+	static bool m_enabled;
+};
@@ -1,6 +1,11 @@
 #pragma once
 #include <Beatmap/BeatmapObjects.hpp>
 
+/*
+	Generates and caches the meshes for laser segments
+	Meshes are generated in view distance units along the track, the length scale is applied by the transform they are drawn with
+	Only the texture tiling of normal segments depends on the length scale, these are regenerated when it changes
+*/
 class LaserTrackBuilder
 {
 public:
@@ -14,10 +19,15 @@ public:
 	// Generate the starting segment of a laser
 	Mesh GenerateTrackEntry(class BeatmapPlayback& playback, LaserObjectState* laser);
 	// Generate the ending segment of a laser
+	// this mesh starts at 0 and should be offset by GetTrackExitDistance
 	Mesh GenerateTrackExit(class BeatmapPlayback& playback, LaserObjectState* laser);
+	// View distance from the start of a laser segment to its exit mesh
+	float GetTrackExitDistance(class BeatmapPlayback& playback, LaserObjectState* laser);
 
 	// Laser length scale at a given position
 	float GetLaserLengthScaleAt(MapTime time);
+	// Changes the length scale, normal segments are regenerated the next time they are used
+	void SetLaserLengthScale(float scale);
 
 	// Used to generate larges meshes but allow the texture to match the actual laser width
 	uint32 laserBorderPixels;
@@ -30,6 +40,7 @@ public:
 	Vector2i laserExitTextureSize;
 
 	// The length scale based on the view distance
+	// only used to determine the texture tiling of normal segments, use SetLaserLengthScale once meshes are generated
 	float laserLengthScale;
 
 	// The length of the horizontal slam segments
@@ -53,7 +64,9 @@ private:
 
 private:
 	void m_RecalculateConstants();
-	void m_Cleanup(MapTime newTime, Map<LaserObjectState*, Mesh>& arr);
+	// Removes meshes of passed lasers, returns the time at which the next mesh in the cache expires
+	MapTime m_Cleanup(MapTime newTime, Map<LaserObjectState*, Mesh>& arr);
+	void m_AddCleanupTime(LaserObjectState* laser);
 	class OpenGL* m_gl;
 	class Track* m_track;
 
@@ -63,4 +76,6 @@ private:
 	Map<LaserObjectState*, Mesh> m_objectCache;
 	Map<LaserObjectState*, Mesh> m_cachedEntries;
 	Map<LaserObjectState*, Mesh> m_cachedExits;
+	// Time when the next cached mesh can be removed
+	MapTime m_nextCleanupTime;
 };
\ No newline at end of file
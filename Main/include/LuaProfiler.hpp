@@ -0,0 +1,70 @@
+#pragma once
+#include "stdafx.h"
+
+struct lua_State;
+struct lua_Debug;
+
+/*
+	Sampling profiler for a single lua state, used by the debug HUD
+	The time between instruction count hooks is attributed to the lua call stack at the hook,
+	allocations are counted by wrapping the allocator of the state
+	The sampled stacks can be written in the collapsed format used by flamegraph tools
+*/
+class LuaProfiler : Unique
+{
+public:
+	struct FrameStats
+	{
+		// Milliseconds spent running lua code
+		float luaTime = 0.0f;
+		uint32 allocations = 0;
+		size_t allocatedBytes = 0;
+		// Memory released by the garbage collector
+		size_t freedBytes = 0;
+		// Memory used by the state at the end of the frame
+		size_t memoryUsed = 0;
+	};
+	struct FunctionTime
+	{
+		String name;
+		// Milliseconds per second
+		float time;
+	};
+
+	LuaProfiler(lua_State* L);
+	// Restores the allocator and removes the hooks, must be destroyed before the state is closed
+	~LuaProfiler();
+
+	// Call once per frame while no lua code is running
+	void EndFrame();
+
+	const FrameStats& GetLastFrameStats() const;
+	// Functions that spent the most time in the last second, sorted by time
+	Vector<FunctionTime> GetTopFunctions(size_t count) const;
+
+	// Writes all sampled stacks as "outer;inner microseconds" lines
+	bool WriteCollapsedStacks(const String& path) const;
+
+private:
+	static void m_Hook(lua_State* L, lua_Debug* ar);
+	static void* m_Alloc(void* ud, void* ptr, size_t osize, size_t nsize);
+	void m_AddTime(lua_State* L);
+
+	lua_State* m_lua;
+	void* m_baseAllocData;
+	void* (*m_baseAlloc)(void*, void*, size_t, size_t);
+
+	// Depth of lua calls made by the host, time outside of them is not counted
+	int32 m_callDepth = 0;
+	Timer m_sampleTimer;
+
+	FrameStats m_frame;
+	FrameStats m_lastFrame;
+
+	// Microseconds per collapsed stack since the profiler was created
+	Map<String, uint64> m_stackTimes;
+	// Milliseconds per function in the current and last second
+	Map<String, float> m_functionTimes;
+	Map<String, float> m_lastFunctionTimes;
+	Timer m_functionTimer;
+};
@@ -1,7 +1,6 @@
 #pragma once
 #include "Scoring.hpp"
 #include "AsyncLoadable.hpp"
-#include <unordered_set>
 
 /*
 	The object responsible for drawing the track.
@@ -46,7 +45,11 @@ public:
 	// Just the board with tick lines
 	void DrawBase(RenderQueue& rq);
 	// Draws an object
-	void DrawObjectState(RenderQueue& rq, class BeatmapPlayback& playback, ObjectState* obj, bool active, const std::unordered_set<MapTime> chipFXTimes[2]);
+	// chips are collected into batches that are drawn by DrawObjectBatches or before the next laser
+	void DrawObjectState(RenderQueue& rq, class BeatmapPlayback& playback, ObjectState* obj, bool active);
+	// Draws all chips collected by DrawObjectState, FX chips first
+	// should be called once per frame after all objects are drawn
+	void DrawObjectBatches(RenderQueue& rq);
 	// Things like the laser pointers, hit bar and effect
 	void DrawOverlays(RenderQueue& rq);
 	// Draws a plane over the track
@@ -175,6 +178,16 @@ private:
 	float m_trackHide = 0.0f;
 	float m_trackHideSpeed = 0.0f;
 	float m_btOverFxScale = 0.8f;
+
+	// Chips of the current frame, transformed to track space so they can be drawn with a single draw call
+	struct ChipBatch
+	{
+		Vector<MeshGenerators::SimpleVertex> verts;
+		Mesh mesh;
+	};
+	// Indexed by [bt/fx][hasSample]
+	ChipBatch m_chipBatches[2][2];
+	bool m_hasChipBatches = false;
 }; 
 
 // Base class for sprite effects on the track
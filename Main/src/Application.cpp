@@ -79,6 +79,68 @@ struct TickableChange
 // Applied at the end of each main loop
 static Vector<TickableChange> g_tickableChanges;
 
+// Steps of the application setup with the time they ran, relative to the start of the setup
+struct StartupStep
+{
+	String name;
+	bool mainThread;
+	int64 begin;
+	int64 end;
+};
+static Timer g_startupTimer;
+static std::mutex g_startupStepsLock;
+static Vector<StartupStep> g_startupSteps;
+
+// Adds its lifetime as a step to the startup timeline
+class StartupScope
+{
+public:
+	StartupScope(const String& name, bool mainThread = true) : m_name(name), m_mainThread(mainThread)
+	{
+		m_begin = g_startupTimer.Milliseconds();
+	}
+	~StartupScope()
+	{
+		End();
+	}
+	// Ends the step before the scope does
+	void End()
+	{
+		if (m_ended)
+			return;
+		m_ended = true;
+		std::lock_guard<std::mutex> lock(g_startupStepsLock);
+		g_startupSteps.Add({ m_name, m_mainThread, m_begin, (int64)g_startupTimer.Milliseconds() });
+	}
+private:
+	String m_name;
+	bool m_mainThread;
+	bool m_ended = false;
+	int64 m_begin;
+};
+
+// Blocks until a job queued during startup has run, these jobs don't use finalizers
+static bool WaitForStartupJob(Job& job)
+{
+	StartupScope $("Wait for job");
+	while (!job->IsFinished())
+		std::this_thread::sleep_for(std::chrono::milliseconds(1));
+	return job->IsSuccessfull();
+}
+
+static void LogStartupTimeline()
+{
+	std::lock_guard<std::mutex> lock(g_startupStepsLock);
+	g_startupSteps.Sort([](const StartupStep& a, const StartupStep& b) { return a.begin < b.begin; });
+	Log("Startup timeline:", Logger::Severity::Info);
+	for (const StartupStep& step : g_startupSteps)
+	{
+		Logf("  %5d - %5d ms [%s] %s", Logger::Severity::Info, (int)step.begin, (int)step.end,
+			step.mainThread ? "main" : "job", step.name);
+	}
+	g_startupSteps.clear();
+}
+
 // Used to set the initial screen size
 static float g_screenHeight = 1000.0f;
 
@@ -704,6 +766,7 @@ void Application::m_InitDiscord()
 bool Application::m_Init()
 {
 	ProfilerScope $("Application Setup");
+	g_startupTimer.Restart();
 
 	String version = Utility::Sprintf("%d.%d.%d", VERSION_MAJOR, VERSION_MINOR, VERSION_PATCH);
 	Logf("Version: %s", Logger::Severity::Info, version.c_str());
@@ -813,6 +876,53 @@ bool Application::m_Init()
 		}
 	}
 
+	// Work that doesn't need the window or the GL context runs on the job threads while those are set up
+	// Jobs still in flight when startup bails out are cancelled or waited for before returning
+	struct StartupJobs
+	{
+		Vector<Job> jobs;
+		~StartupJobs()
+		{
+			for (Job& job : jobs)
+				job->Terminate();
+		}
+	} startupJobs;
+	Job skinJob = JobBase::CreateLambda([this]()
+	{
+		StartupScope $("Unpack skins", false);
+		m_unpackSkins();
+		return true;
+	});
+	skinJob->jobFlags = JobFlags::IO;
+	g_jobSheduler->Queue(skinJob);
+	startupJobs.jobs.Add(skinJob);
+
+	// The CJK fallback font is large, read it before nanovg needs it
+	struct FontData
+	{
+		unsigned char* data = nullptr;
+		int size = 0;
+		// Only freed here if it was never handed to nanovg
+		~FontData() { free(data); }
+	};
+	Ref<FontData> fallbackFont = Utility::MakeRef(new FontData());
+	Job fontJob = JobBase::CreateLambda([fallbackFont]()
+	{
+		StartupScope $("Read fallback font", false);
+		File file;
+		if (!file.OpenRead(Path::Absolute("fonts/NotoSansCJKjp-Regular.otf")))
+			return false;
+		fallbackFont->size = (int)file.GetSize();
+		// Ownership passes to nanovg once the font is created
+		fallbackFont->data = (unsigned char*)malloc(fallbackFont->size);
+		return file.Read(fallbackFont->data, fallbackFont->size) == (size_t)fallbackFont->size;
+	});
+	fontJob->jobFlags = JobFlags::IO;
+	g_jobSheduler->Queue(fontJob);
+	startupJobs.jobs.Add(fontJob);
+
+	StartupScope windowStep("Create window");
+
 	// Init font library
 	if (!Graphics::FontRes::InitLibrary())
 		return false;
@@ -843,8 +953,9 @@ bool Application::m_Init()
 
 	// Initialize Input
 	g_input.Init(*g_gameWindow);
+	windowStep.End();
 
-	m_unpackSkins();
+	WaitForStartupJob(skinJob);
 
 	// Set skin variable
 	if (g_isPlayback)
@@ -864,9 +975,17 @@ bool Application::m_Init()
 	}
 
 	g_skinConfig = new SkinConfig(m_skin);
-	// Window cursor
-	Image cursorImg = ImageRes::Create(Path::Absolute("skins/" + m_skin + "/textures/cursor.png"));
-	g_gameWindow->SetCursor(cursorImg, Vector2i(5, 5));
+	// Window cursor, decoded while audio and GL are initialized
+	Ref<Image> cursorImg = Utility::MakeRef(new Image());
+	Job cursorJob = JobBase::CreateLambda([cursorImg, this]()
+	{
+		StartupScope $("Decode cursor", false);
+		*cursorImg = ImageRes::Create(Path::Absolute("skins/" + m_skin + "/textures/cursor.png"));
+		return true;
+	});
+	cursorJob->jobFlags = JobFlags::IO;
+	g_jobSheduler->Queue(cursorJob);
+	startupJobs.jobs.Add(cursorJob);
 
 	if (startFullscreen)
 		g_gameWindow->SwitchFullscreen(
@@ -881,6 +1000,7 @@ bool Application::m_Init()
 
 	{
 		ProfilerScope $1("Audio Init");
+		StartupScope $2("Audio init");
 
 		// Init audio
 		new Audio();
@@ -916,6 +1036,7 @@ bool Application::m_Init()
 
 	{
 		ProfilerScope $1("GL Init");
+		StartupScope $2("GL init");
 
 		// Create graphics context
 		g_gl = new OpenGL();
@@ -937,14 +1058,31 @@ bool Application::m_Init()
 		g_guiState.vg = nvgCreateGL3(0);
 #endif
 #endif
-		nvgCreateFont(g_guiState.vg, "fallback", *Path::Absolute("fonts/NotoSansCJKjp-Regular.otf"));
+		if (WaitForStartupJob(fontJob))
+		{
+			nvgCreateFontMem(g_guiState.vg, "fallback", fallbackFont->data, fallbackFont->size, 1);
+			fallbackFont->data = nullptr;
+		}
+		else
+		{
+			nvgCreateFont(g_guiState.vg, "fallback", *Path::Absolute("fonts/NotoSansCJKjp-Regular.otf"));
+		}
+		g_guiState.animationMemoryBudget = (size_t)Math::Max(0, g_gameConfig.GetInt(GameConfigKeys::AnimationMemoryBudget)) * 1024 * 1024;
+
+		// About four 512x512 jackets per frame
+		m_textureUploader = new TextureUploader(g_gl, 4 * 1024 * 1024);
+		JacketCache::Init((size_t)Math::Max(0, g_gameConfig.GetInt(GameConfigKeys::JacketCacheSize)) * 1024 * 1024);
 	}
 
+	WaitForStartupJob(cursorJob);
+	g_gameWindow->SetCursor(*cursorImg, Vector2i(5, 5));
+
 	CheckForUpdate();
 
 
 	m_InitDiscord();
 
+	StartupScope materialStep("Load materials and gauge");
 	CheckedLoad(m_fontMaterial = LoadMaterial("font"));
 	m_fontMaterial->opaque = false;
 	CheckedLoad(m_fillMaterial = LoadMaterial("guiColor"));
@@ -953,6 +1091,7 @@ bool Application::m_Init()
 	m_guiTex->opaque = false;
 	m_gauge = new HealthGauge();
 	LoadGauge(false);
+	materialStep.End();
 
 	//m_skinHtpp = new SkinHttp();
 	// call the initial OnWindowResized now that we have intialized OpenGL
@@ -963,6 +1102,7 @@ bool Application::m_Init()
 
 	{
 		ProfilerScope $("Load Transition Screens");
+		StartupScope $1("Load transition screens");
 #ifndef PLAYBACK
 		g_transition = TransitionScreen::Create();
 #endif
@@ -973,6 +1113,7 @@ bool Application::m_Init()
 	Path::CreateDir(Path::Absolute("songs"));
 	Path::CreateDir(Path::Absolute("replays"));
 	Path::CreateDir(Path::Absolute("crash_dumps"));
+	LogStartupTimeline();
 	Logger::Get().SetLogLevel(g_gameConfig.GetEnum<Logger::Enum_Severity>(GameConfigKeys::LogLevel));
 	return true;
 }
@@ -1155,6 +1296,8 @@ void Application::m_MainLoop()
 		// processed callbacks for finished tasks
 		g_jobSheduler->Update();
 
+		m_UploadPendingJackets();
+
 		//This FPS limiter seems unstable over 500fps
 		uint32 frameTime = frameTimer.Microseconds();
 		if (frameTime < targetRenderTime)
@@ -1313,6 +1456,8 @@ void Application::m_Tick()
 		glCullFace(GL_FRONT);
 	}
 
+	m_StepLuaGC();
+
 	if (m_needSkinReload)
 	{
 		m_needSkinReload = false;
@@ -1345,6 +1490,13 @@ void Application::m_Cleanup()
 		g_audio = nullptr;
 	}
 
+	m_pendingJacketUploads.clear();
+	if (m_textureUploader)
+	{
+		delete m_textureUploader;
+		m_textureUploader = nullptr;
+	}
+
 	if (g_gl)
 	{
 		delete g_gl;
@@ -1601,6 +1753,62 @@ int Application::LoadImageJob(const String &path, Vector2i size, int placeholder
 	return ret;
 }
 
+void Application::QueueJacketUpload(CachedJacketImage *image)
+{
+	m_pendingJacketUploads.AddBack(image);
+}
+
+void Application::m_UploadPendingJackets()
+{
+	m_textureUploader->NewFrame();
+	while (!m_pendingJacketUploads.empty())
+	{
+		CachedJacketImage *jacket = m_pendingJacketUploads.front();
+		JacketCache::Entry &compressed = jacket->pendingCompressed;
+		if (!compressed.blocks.empty())
+		{
+			if (!m_textureUploader->HasBudget(compressed.blocks.size()))
+				break;
+			m_pendingJacketUploads.pop_front();
+
+			// NanoVG can't create compressed images itself, wrap a texture created here instead
+			uint32 handle = 0;
+			glGenTextures(1, &handle);
+			m_textureUploader->UploadCompressed(handle, compressed.size, JacketCache::GetTextureFormat(), compressed.blocks);
+			glBindTexture(GL_TEXTURE_2D, handle);
+			glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+			glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+			glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+			glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+			glBindTexture(GL_TEXTURE_2D, 0);
+#ifdef EMBEDDED
+			jacket->texture = nvglCreateImageFromHandleGLES2(g_guiState.vg, handle, compressed.size.x, compressed.size.y, 0);
+#else
+			jacket->texture = nvglCreateImageFromHandleGL3(g_guiState.vg, handle, compressed.size.x, compressed.size.y, 0);
+#endif
+			compressed = JacketCache::Entry();
+			jacket->loaded = true;
+			continue;
+		}
+
+		Vector2i size = jacket->pendingImage->GetSize();
+		if (!m_textureUploader->HasBudget((size_t)size.x * size.y * sizeof(Colori)))
+			break;
+		m_pendingJacketUploads.pop_front();
+
+		// Create the texture without data, the pixels are streamed in by the uploader
+		jacket->texture = nvgCreateImageRGBA(g_guiState.vg, size.x, size.y, 0, nullptr);
+#ifdef EMBEDDED
+		uint32 handle = nvglImageHandleGLES2(g_guiState.vg, jacket->texture);
+#else
+		uint32 handle = nvglImageHandleGL3(g_guiState.vg, jacket->texture);
+#endif
+		m_textureUploader->Upload(handle, jacket->pendingImage);
+		jacket->pendingImage.reset();
+		jacket->loaded = true;
+	}
+}
+
 void Application::SetScriptPath(lua_State *s)
 {
 	//Set path for 'require' (https://stackoverflow.com/questions/4125971/setting-the-global-lua-path-variable-from-c-c?lq=1)
@@ -1646,7 +1854,7 @@ lua_State *Application::LoadScript(const String &name, bool noError)
 	}
 
 	SetLuaBindings(s);
-	if (luaL_dofile(s, commonPath.c_str()) || luaL_dofile(s, path.c_str()))
+	if (!DoScriptFile(s, commonPath) || !DoScriptFile(s, path))
 	{
 		Logf("Lua error: %s", Logger::Severity::Error, lua_tostring(s, -1));
 		if (!noError)
@@ -1656,9 +1864,73 @@ lua_State *Application::LoadScript(const String &name, bool noError)
 	}
 	else
 		g_luaErrorsSeen.clear();
+	RegisterLuaGC(s);
 	return s;
 }
 
+static int WriteScriptChunk(lua_State *L, const void *data, size_t size, void *userData)
+{
+	((String *)userData)->append((const char *)data, size);
+	return 0;
+}
+
+bool Application::DoScriptFile(lua_State *L, const String &path)
+{
+	File file;
+	if (!file.OpenRead(path))
+	{
+		lua_pushfstring(L, "cannot open %s", *path);
+		return false;
+	}
+	String source;
+	source.resize(file.GetSize());
+	if (!source.empty())
+		file.Read(&source.front(), source.size());
+
+	// FNV-1a
+	uint64 sourceHash = 14695981039346656037ULL;
+	for (char c : source)
+	{
+		sourceHash ^= (uint8)c;
+		sourceHash *= 1099511628211ULL;
+	}
+
+	String chunkName = "@" + path;
+	int status;
+	CachedScript *cached = m_scriptCache.Find(path);
+	if (cached && cached->sourceHash == sourceHash)
+	{
+		status = luaL_loadbufferx(L, cached->bytecode.data(), cached->bytecode.size(), *chunkName, "b");
+	}
+	else
+	{
+		// Skip the same things luaL_loadfile does, a UTF-8 BOM and a first line starting with #
+		size_t offset = 0;
+		if (source.compare(0, 3, "\xEF\xBB\xBF") == 0)
+			offset = 3;
+		if (offset < source.size() && source[offset] == '#')
+		{
+			// Keep the newline so line numbers stay the same
+			offset = source.find('\n', offset);
+			if (offset == String::npos)
+				offset = source.size();
+		}
+
+		status = luaL_loadbufferx(L, source.data() + offset, source.size() - offset, *chunkName, nullptr);
+		if (status == LUA_OK)
+		{
+			// Debug info is kept so errors still point at the source lines
+			CachedScript &entry = m_scriptCache[path];
+			entry.sourceHash = sourceHash;
+			entry.bytecode.clear();
+			lua_dump(L, WriteScriptChunk, &entry.bytecode, 0);
+		}
+	}
+	if (status != LUA_OK)
+		return false;
+	return lua_pcall(L, 0, LUA_MULTRET, 0) == LUA_OK;
+}
+
 // TODO add option for this
 void Application::ShowLuaError(const String &error)
 {
@@ -1679,10 +1951,11 @@ void Application::ReloadScript(const String &name, lua_State *L)
 	m_skinHttp.ClearState(L);
 	path = Path::Absolute(path);
 	commonPath = Path::Absolute(commonPath);
-	if (luaL_dofile(L, commonPath.c_str()) || luaL_dofile(L, path.c_str()))
+	if (!DoScriptFile(L, commonPath) || !DoScriptFile(L, path))
 	{
 		Logf("Lua error: %s", Logger::Severity::Error, lua_tostring(L, -1));
 		g_gameWindow->ShowMessageBox("Lua Error", lua_tostring(L, -1), 0);
+		m_UnregisterLuaGC(L);
 		lua_close(L);
 		assert(false);
 	}
@@ -1725,6 +1998,7 @@ void Application::ReloadSkin()
 	g_guiState.nextPaintId.clear();
 	g_guiState.paintCache.clear();
 	m_jacketImages.clear();
+	m_pendingJacketUploads.clear();
 
 	for (auto &sample : m_samples)
 	{
@@ -1770,8 +2044,100 @@ void Application::DisposeLua(lua_State *state)
 {
 	DisposeGUI(state);
 	m_skinHttp.ClearState(state);
+	m_UnregisterLuaGC(state);
 	lua_close(state);
 }
+
+static size_t GetLuaMemory(lua_State *L)
+{
+	return (size_t)lua_gc(L, LUA_GCCOUNT, 0) * 1024 + (size_t)lua_gc(L, LUA_GCCOUNTB, 0);
+}
+// Memory usage relative to the live memory after a cycle at which the next cycle starts, same as the default lua pause
+static const size_t luaGCPause = 2;
+// Don't bother collecting states smaller than this
+static const size_t luaGCMinThreshold = 1024 * 1024;
+
+void Application::RegisterLuaGC(lua_State *state)
+{
+	lua_gc(state, LUA_GCSTOP, 0);
+	LuaGCState gcState;
+	gcState.L = state;
+	gcState.lastMemory = GetLuaMemory(state);
+	gcState.threshold = Math::Max(gcState.lastMemory * luaGCPause, luaGCMinThreshold);
+	m_luaGCStates.Add(gcState);
+}
+void Application::m_UnregisterLuaGC(lua_State *state)
+{
+	for (auto it = m_luaGCStates.begin(); it != m_luaGCStates.end(); it++)
+	{
+		if (it->L == state)
+		{
+			m_luaGCStates.erase(it);
+			return;
+		}
+	}
+}
+void Application::CollectLuaGarbage()
+{
+	Timer timer;
+	for (LuaGCState &state : m_luaGCStates)
+	{
+		lua_gc(state.L, LUA_GCCOLLECT, 0);
+		state.collecting = false;
+		state.lastMemory = GetLuaMemory(state.L);
+		state.threshold = Math::Max(state.lastMemory * luaGCPause, luaGCMinThreshold);
+	}
+	m_luaGCStats.lastFullCollectTime = timer.SecondsAsFloat() * 1000.0f;
+}
+const Application::LuaGCStats &Application::GetLuaGCStats() const
+{
+	return m_luaGCStats;
+}
+void Application::m_StepLuaGC()
+{
+	Timer timer;
+	const int64 budget = g_gameConfig.GetInt(GameConfigKeys::LuaGCBudget);
+	const size_t count = m_luaGCStates.size();
+	for (size_t i = 0; i < count; i++)
+	{
+		// Start with a different state every frame so a busy state doesn't use up the budget of the others
+		LuaGCState &state = m_luaGCStates[(m_nextLuaGCState + i) % count];
+		size_t memory = GetLuaMemory(state.L);
+		if (!state.collecting)
+		{
+			state.lastMemory = memory;
+			if (memory < state.threshold)
+				continue;
+			state.collecting = true;
+		}
+
+		// The work for what was allocated since the last frame is always done, as the automatic collector would,
+		// so states allocating heavily don't outgrow their collection. The remaining budget is spent getting ahead.
+		size_t owedKB = memory > state.lastMemory ? (memory - state.lastMemory) / 1024 : 0;
+		bool cycleDone = lua_gc(state.L, LUA_GCSTEP, (int)Math::Max<size_t>(owedKB, 1)) != 0;
+		while (!cycleDone && timer.Microseconds() < budget)
+			cycleDone = lua_gc(state.L, LUA_GCSTEP, 0) != 0;
+
+		state.lastMemory = GetLuaMemory(state.L);
+		if (cycleDone)
+		{
+			state.collecting = false;
+			state.threshold = Math::Max(state.lastMemory * luaGCPause, luaGCMinThreshold);
+			m_luaGCStats.cyclesCompleted++;
+		}
+	}
+	if (count > 0)
+		m_nextLuaGCState = (m_nextLuaGCState + 1) % count;
+
+	m_luaGCStats.lastFrameTime = timer.SecondsAsFloat() * 1000.0f;
+	m_luaGCMaxFrameTime = Math::Max(m_luaGCMaxFrameTime, m_luaGCStats.lastFrameTime);
+	if (m_luaGCStatsTimer.Milliseconds() >= 1000)
+	{
+		m_luaGCStats.maxFrameTime = m_luaGCMaxFrameTime;
+		m_luaGCMaxFrameTime = 0.0f;
+		m_luaGCStatsTimer.Restart();
+	}
+}
 void Application::SetGaugeColor(int i, Color c)
 {
 	m_gaugeColors[i] = c;
@@ -2707,7 +3073,7 @@ bool JacketLoadingJob::Run()
 		Buffer b;
 		b.resize(response.text.length());
 		memcpy(b.data(), response.text.c_str(), b.size());
-		loadedImage = ImageRes::Create(b);
+		loadedImage = ImageRes::Create(b, {w, h});
 		if (loadedImage)
 		{
 			if (loadedImage->GetSize().x > w || loadedImage->GetSize().y > h)
@@ -2719,23 +3085,32 @@ bool JacketLoadingJob::Run()
 	}
 	else
 	{
-		loadedImage = ImageRes::Create(imagePath);
+		// Only downscaled jackets are cached, full size images are rare and large
+		bool useCache = JacketCache::IsEnabled() && w > 0 && h > 0;
+		if (useCache && JacketCache::Load(imagePath, {w, h}, compressedImage))
+			return true;
+
+		loadedImage = ImageRes::Create(imagePath, {w, h});
 		if (loadedImage)
 		{
 			if (loadedImage->GetSize().x > w || loadedImage->GetSize().y > h)
 			{
 				loadedImage->ReSize({w, h});
 			}
+			if (useCache && JacketCache::Store(imagePath, {w, h}, loadedImage, compressedImage))
+				loadedImage.reset();
 		}
-		return loadedImage.get() != nullptr;
+		return loadedImage.get() != nullptr || !compressedImage.blocks.empty();
 	}
 }
 void JacketLoadingJob::Finalize()
 {
 	if (IsSuccessfull())
 	{
-		///TODO: Maybe do the nvgCreateImage in Run() instead
-		target->texture = nvgCreateImageRGBA(g_guiState.vg, loadedImage->GetSize().x, loadedImage->GetSize().y, 0, (unsigned char *)loadedImage->GetBits());
-		target->loaded = true;
+		// Uploaded over the next frames to not stall when many jackets finish at once
+		target->pendingImage = loadedImage;
+		target->pendingCompressed = std::move(compressedImage);
+		loadedImage.reset();
+		g_application->QueueJacketUpload(target);
 	}
 }
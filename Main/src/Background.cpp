@@ -72,7 +72,7 @@ class TestBackground : public FullscreenBackground
 private:
 	bool m_init(String path)
 	{
-		if (luaL_dofile(lua, Path::Normalize(path + ".lua").c_str()))
+		if (!g_application->DoScriptFile(lua, Path::Normalize(path + ".lua")))
 		{
 			Logf("Lua error: %s", Logger::Severity::Warning, lua_tostring(lua, -1));
 			return false;
@@ -105,6 +105,7 @@ public:
 
 		String skin = g_gameConfig.GetString(GameConfigKeys::Skin);
 		lua = luaL_newstate();
+		g_application->RegisterLuaGC(lua);
 
 		auto openLib = [this](const char *name, lua_CFunction lib) {
 			luaL_requiref(lua, name, lib, 1);
@@ -4,7 +4,6 @@
 #include "Audio/Audio.hpp"
 #include "SettingsScreen.hpp"
 #include "../third_party/nuklear/nuklear.h"
-#include <unordered_set>
 
 
 CalibrationScreen::CalibrationScreen(nk_context* nk_ctx)
@@ -74,15 +73,15 @@ void CalibrationScreen::Render(float deltaTime)
 	RenderQueue renderQueue(g_gl, rs);
 
 	MapTime msViewRange = m_playback.ViewDistanceToDuration(m_track.GetViewRange());
-	auto currentObjectSet = m_playback.GetObjectsInRange(msViewRange);
+	const Vector<ObjectState*>& currentObjectSet = m_playback.GetObjectsInRange(msViewRange);
 
 	m_track.DrawBase(renderQueue);
-	std::unordered_set<MapTime> chipFXTimes[2];
 
 	for (auto& object : currentObjectSet)
 	{
-		m_track.DrawObjectState(renderQueue, m_playback, object, false, chipFXTimes);
+		m_track.DrawObjectState(renderQueue, m_playback, object, false);
 	}
+	m_track.DrawObjectBatches(renderQueue);
 	if (m_trackCover)
 	{
 		m_track.DrawTrackCover(renderQueue);
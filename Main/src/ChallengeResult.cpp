@@ -16,6 +16,7 @@
 #include <Beatmap/TinySHA1.hpp>
 #include "MultiplayerScreen.hpp"
 #include "ChatOverlay.hpp"
+#include "Shared/Jobs.hpp"
 
 class ChallengeResultScreen_Impl : public ChallengeResultScreen
 {
@@ -38,6 +39,7 @@ private:
 	bool m_removed = false;
 	bool m_hasScreenshot = false;
 	bool m_hasRendered = false;
+	Ref<ScreenshotSaver> m_screenshot;
 
 	LuaBindable* m_bindable = nullptr;
 
@@ -176,7 +178,7 @@ public:
 			lua_pushstring(m_lua, "highScores");
 			lua_newtable(m_lua);
 			int scoreIndex = 1;
-			for (auto& score : chart->scores)
+			for (auto& score : chart->GetAllScores())
 			{
 				lua_pushinteger(m_lua, scoreIndex++);
 				lua_newtable(m_lua);
@@ -347,6 +349,9 @@ public:
 	}
 	virtual void Tick(float deltaTime) override
 	{
+		if (m_screenshot)
+			m_screenshot->Update();
+
 		if (!m_hasScreenshot && m_hasRendered && !IsSuspended())
 		{
 			AutoScoreScreenshotSettings screensetting = g_gameConfig.GetEnum<Enum_AutoScoreScreenshotSettings>(GameConfigKeys::AutoScoreScreenshot);
@@ -376,6 +381,10 @@ public:
 
 	void Capture()
 	{
+		// Only one screenshot in flight at a time
+		if (m_screenshot && !m_screenshot->IsDone())
+			return;
+
 		auto luaPopInt = [this]
 		{
 			int a = lua_tonumber(m_lua, lua_gettop(m_lua));
@@ -418,18 +427,14 @@ public:
 			}
 		}
 		Vector2i size(w, h);
-		Image screenshot = ImageRes::Screenshot(g_gl, size, { x,y });
+		// The pixels are picked up in Tick once the GPU has copied them
 		String screenshotPath = "screenshots/" + Shared::Time::Now().ToString() + ".png";
-		if (screenshot.get() != nullptr)
-		{
-			screenshot->SavePNG(screenshotPath);
-			screenshot.reset();
-		}
-		else 
-		{
-			screenshotPath = "Failed to capture screenshot";
-		}
-
+		int32 compressionLevel = g_gameConfig.GetInt(GameConfigKeys::ScreenshotCompressionLevel);
+		m_screenshot = Ref<ScreenshotSaver>(new ScreenshotSaver(g_gl, g_jobSheduler, screenshotPath, size, { x,y }, compressionLevel));
+		m_screenshot->OnSaved.Add(this, &ChallengeResultScreen_Impl::m_OnScreenshotCaptured);
+	}
+	void m_OnScreenshotCaptured(const String& screenshotPath)
+	{
 		lua_getglobal(m_lua, "screenshot_captured");
 		if (lua_isfunction(m_lua, -1))
 		{
@@ -28,6 +28,7 @@
 #include "GUI/HealthGauge.hpp"
 #include "PracticeModeSettingsDialog.hpp"
 #include "Audio/OffsetComputer.hpp"
+#include "LuaProfiler.hpp"
 
 #include <SDL2/SDL.h>
 
@@ -78,6 +79,8 @@ private:
 	bool m_saveSpeed = false;
 
 	bool m_renderDebugHUD = false;
+	// Only attached while the debug HUD is shown
+	LuaProfiler* m_luaProfiler = nullptr;
 
 	MultiplayerScreen* m_multiplayer = nullptr;
 	ChallengeManager* m_challengeManager = nullptr;
@@ -149,8 +152,6 @@ private:
 
 	// Currently active timing point
 	const TimingPoint* m_currentTiming;
-	// Currently visible gameplay objects
-	Vector<ObjectState*> m_currentObjectSet;
 
 	// Rate to sample gauge;
 	MapTime m_gaugeSampleRate;
@@ -228,6 +229,8 @@ public:
 			delete m_background;
 		if (m_foreground)
 			delete m_foreground;
+		if (m_luaProfiler)
+			delete m_luaProfiler;
 		if (m_lua)
 		{
 			g_application->DisposeLua(m_lua);
@@ -372,7 +375,7 @@ public:
 
 		// Load replays
 		if (m_chartIndex)
-			for (ScoreIndex* score : m_chartIndex->scores)
+			for (ScoreIndex* score : m_chartIndex->GetAllScores())
 			{
 				File replayFile;
 				if (replayFile.OpenRead(score->replayPath)) {
@@ -464,6 +467,7 @@ public:
 		m_lua = g_application->LoadScript("gameplay");
 		if (!m_lua)
 			return false;
+		m_UpdateLuaProfiler();
 
 		if (g_gameConfig.GetBool(GameConfigKeys::EnableHiddenSudden)) {
 			m_track->suddenCutoff = g_gameConfig.GetFloat(GameConfigKeys::SuddenCutoff);
@@ -882,8 +886,8 @@ public:
 		if(m_background)
 			m_background->Render(deltaTime);
 
-		// Main render queue
-		RenderQueue renderQueue(g_gl, rs);
+		// Main render queue, sorted so runs of additive laser draws are grouped by state
+		RenderQueue renderQueue(g_gl, rs, RenderQueueSortMode::SortKey);
 
 		// Get objects in range
 		MapTime msViewRange = m_playback.ViewDistanceToDuration(m_track->GetViewRange());
@@ -891,47 +895,22 @@ public:
 		{
 			msViewRange = 480000.0 / m_playback.cModSpeed;
 		}
-		m_currentObjectSet = m_playback.GetObjectsInRange(msViewRange);
-		// Sort objects to draw
-		// fx holds -> bt holds -> fx chips -> bt chips
-		m_currentObjectSet.Sort([](const TObjectState<void>* a, const TObjectState<void>* b)
-		{
-			auto ObjectRenderPriorty = [](const TObjectState<void>* a)
-			{
-				if (a->type == ObjectType::Single)
-					return (((ButtonObjectState*)a)->index < 4) ? 1 : 2;
-				else if (a->type == ObjectType::Hold)
-					return (((ButtonObjectState*)a)->index < 4) ? 3 : 4;
-				else
-					return 0;
-			};
-			uint32 renderPriorityA = ObjectRenderPriorty(a);
-			uint32 renderPriorityB = ObjectRenderPriorty(b);
-			return renderPriorityA > renderPriorityB;
-		});
-
-		//TODO: Set as bool on the button object during parsing(?)
-		std::unordered_set<MapTime> chipFXTimes[2];
-		for (const auto& obj : m_currentObjectSet) {
-			if (obj->type == ObjectType::Single) {
-				auto b = (ButtonObjectState*)obj;
-				if (b->index > 3) {
-					chipFXTimes[b->index - 4].insert(b->time);
-				}
-			}
-		}
+		// Objects are returned in draw order
+		// fx holds -> bt holds -> fx chips -> bt chips -> lasers
+		const Vector<ObjectState*>& currentObjectSet = m_playback.GetObjectsInRange(msViewRange);
 
 		/// TODO: Performance impact analysis.
-		m_track->DrawLaserBase(renderQueue, m_playback, m_currentObjectSet);
+		m_track->DrawLaserBase(renderQueue, m_playback, currentObjectSet);
 
 		// Draw the base track + time division ticks
 		m_track->DrawBase(renderQueue);
 
-		for(auto& object : m_currentObjectSet)
+		for(auto& object : currentObjectSet)
 		{
 			if(m_hiddenObjects.find(object) == m_hiddenObjects.end())
-				m_track->DrawObjectState(renderQueue, m_playback, object, m_scoring.IsObjectHeld(object), chipFXTimes);
+				m_track->DrawObjectState(renderQueue, m_playback, object, m_scoring.IsObjectHeld(object));
 		}
+		m_track->DrawObjectBatches(renderQueue);
 		if(m_showCover)
 			m_track->DrawTrackCover(renderQueue);
 
@@ -939,7 +918,7 @@ public:
 		//	this is because otherwise some of the scoring elements would get clipped to
 		//	the track's near and far planes
 		rs = m_camera.CreateRenderState(false);
-		RenderQueue scoringRq(g_gl, rs);
+		RenderQueue scoringRq(g_gl, rs, RenderQueueSortMode::SortKey);
 
 		// Copy over laser position and extend info
 		for(uint32 i = 0; i < 2; i++)
@@ -1129,6 +1108,8 @@ public:
 		{
 			RenderDebugHUD(deltaTime);
 		}
+		if(m_luaProfiler)
+			m_luaProfiler->EndFrame();
 
 		if (m_practiceSetupDialog)
 			m_practiceSetupDialog->Render(deltaTime);
@@ -1852,6 +1833,21 @@ public:
 		textPos.y += RenderText(bms.title, textPos).y;
 		textPos.y += RenderText(bms.artist, textPos).y;
 		textPos.y += RenderText(Utility::Sprintf("%.2f FPS", g_application->GetRenderFPS()), textPos).y;
+		const RenderStats& renderStats = g_gl->GetLastFrameRenderStats();
+		textPos.y += RenderText(Utility::Sprintf("Draw calls: %u | Material: %u, Mesh: %u, Blend: %u changes | Glyph uploads: %u",
+			renderStats.drawCalls, renderStats.materialChanges, renderStats.meshChanges, renderStats.blendChanges, renderStats.glyphUploads), textPos).y;
+		if(m_luaProfiler)
+		{
+			const LuaProfiler::FrameStats& luaStats = m_luaProfiler->GetLastFrameStats();
+			textPos.y += RenderText(Utility::Sprintf("Lua: %.2f ms | Allocs: %u (%.1f KB) | Freed: %.1f KB | Memory: %.1f MB",
+				luaStats.luaTime, luaStats.allocations, luaStats.allocatedBytes / 1024.0f, luaStats.freedBytes / 1024.0f,
+				luaStats.memoryUsed / (1024.0f * 1024.0f)), textPos).y;
+			const Application::LuaGCStats& gcStats = g_application->GetLuaGCStats();
+			textPos.y += RenderText(Utility::Sprintf("Lua GC: %.2f ms (max %.2f ms) | Cycles: %u | Last full collect: %.2f ms",
+				gcStats.lastFrameTime, gcStats.maxFrameTime, gcStats.cyclesCompleted, gcStats.lastFullCollectTime), textPos).y;
+			for(const LuaProfiler::FunctionTime& function : m_luaProfiler->GetTopFunctions(5))
+				textPos.y += RenderText(Utility::Sprintf("  %.2f ms/s %s", function.time, function.name), textPos).y;
+		}
 		textPos.y += RenderText(Utility::Sprintf("Offset (ms): Global %d, Song %d, Audio %d (%d)",
 			m_globalOffset, m_songOffset, GetAudioOffset(), g_audio->audioLatency), textPos).y;
 
@@ -2286,6 +2282,14 @@ public:
 		else if(code == SDL_SCANCODE_F8)
 		{
 			m_renderDebugHUD = !m_renderDebugHUD;
+			m_UpdateLuaProfiler();
+		}
+		else if(code == SDL_SCANCODE_F7 && m_luaProfiler)
+		{
+			// Dump the sampled lua stacks for flamegraph tools
+			String path = Path::Absolute("lua_profile.folded");
+			if(m_luaProfiler->WriteCollapsedStacks(path))
+				Logf("Wrote lua profile to \"%s\"", Logger::Severity::Info, path);
 		}
 		else if(code == SDL_SCANCODE_TAB)
 		{
@@ -2298,6 +2302,19 @@ public:
 		}
 	}
 
+	void m_UpdateLuaProfiler()
+	{
+		if(m_renderDebugHUD && m_lua && !m_luaProfiler)
+		{
+			m_luaProfiler = new LuaProfiler(m_lua);
+		}
+		else if(!m_renderDebugHUD && m_luaProfiler)
+		{
+			delete m_luaProfiler;
+			m_luaProfiler = nullptr;
+		}
+	}
+
 	void OnKeyReleased(SDL_Scancode code) override
 	{
 		if (m_practiceSetupDialog && m_practiceSetupDialog->IsActive())
@@ -2422,29 +2439,51 @@ public:
 		return Scoring::CalculateBadge(scoreData);
 	}
 
+	// Pushes the table in field <name> of the table on top of the stack, creating it if it does not exist yet
+	// existing tables are reused so updating them every frame does not create garbage
+	static void m_getOrCreateLuaTable(lua_State* L, const char* name)
+	{
+		lua_getfield(L, -1, name);
+		if (!lua_istable(L, -1))
+		{
+			lua_pop(L, 1);
+			lua_newtable(L);
+			lua_pushvalue(L, -1);
+			lua_setfield(L, -3, name);
+		}
+	}
+	// Same as above for an integer key
+	static void m_getOrCreateLuaTable(lua_State* L, lua_Integer index)
+	{
+		lua_geti(L, -1, index);
+		if (!lua_istable(L, -1))
+		{
+			lua_pop(L, 1);
+			lua_newtable(L);
+			lua_pushvalue(L, -1);
+			lua_seti(L, -3, index);
+		}
+	}
+
 	void m_setLuaHolds(lua_State* L)
 	{
 		//button
-		lua_pushstring(L, "noteHeld");
-		lua_newtable(L);
+		m_getOrCreateLuaTable(L, "noteHeld");
 		for (size_t i = 0; i < 6; i++)
 		{
-			lua_pushnumber(L, i + 1);
 			lua_pushboolean(L, m_scoring.IsObjectHeld(i));
-			lua_settable(L, -3);
+			lua_seti(L, -2, i + 1);
 		}
-		lua_settable(L, -3);
+		lua_pop(L, 1);
 
 		//laser
-		lua_pushstring(L, "laserActive");
-		lua_newtable(L);
+		m_getOrCreateLuaTable(L, "laserActive");
 		for (size_t i = 0; i < 2; i++)
 		{
-			lua_pushnumber(L, i + 1);
 			lua_pushboolean(L, m_scoring.IsObjectHeld(6 + i));
-			lua_settable(L, -3);
+			lua_seti(L, -2, i + 1);
 		}
-		lua_settable(L, -3);
+		lua_pop(L, 1);
 	}
 
 	// Skips ahead to the right before the first object in the map
@@ -2860,20 +2899,19 @@ public:
 		}
 
 		// Update score replays
-		lua_getfield(L, -1, "scoreReplays");
+		m_getOrCreateLuaTable(L, "scoreReplays");
 		int replayCounter = 1;
 
 		if (g_isPlayback)
 		{
-			lua_pushnumber(L, replayCounter);
+			m_getOrCreateLuaTable(L, replayCounter);
 
-			lua_newtable(L);
 			lua_pushstring(L, "currentScore");
 			// TODO only works on two atm
 			lua_pushnumber(L, g_playbackScores[this->GetWindowIndex()^1]);
 			lua_settable(L, -3);
 
-			lua_settable(L, -3);
+			lua_pop(L, 1);
 			replayCounter++;
 		}
 		else
@@ -2894,22 +2932,21 @@ public:
 						replay.nextHitStat++;
 					}
 				}
-				lua_pushnumber(L, replayCounter);
-				lua_newtable(L);
+				m_getOrCreateLuaTable(L, replayCounter);
 
 				lua_pushstring(L, "maxScore");
 				lua_pushnumber(L, replay.maxScore);
 				lua_settable(L, -3);
 
-			lua_pushstring(L, "currentScore");
-			lua_pushnumber(L, m_scoring.CalculateCurrentDisplayScore(replay));
-			lua_settable(L, -3);
-
+				lua_pushstring(L, "currentScore");
+				lua_pushnumber(L, m_scoring.CalculateCurrentDisplayScore(replay));
 				lua_settable(L, -3);
+
+				lua_pop(L, 1);
 				replayCounter++;
 			}
 		}
-		lua_setfield(L, -1, "scoreReplays");
+		lua_pop(L, 1); // scoreReplays
 
 		// progress
 		m_LuaUpdateProgress(L);
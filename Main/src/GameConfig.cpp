@@ -98,6 +98,9 @@ void GameConfig::InitDefaults()
 	Set(GameConfigKeys::DistantButtonScale, 1.0f);
 	Set(GameConfigKeys::BTOverFXScale, 0.8f);
 	Set(GameConfigKeys::DisableBackgrounds, false);
+	Set(GameConfigKeys::AnimationMemoryBudget, 256);
+	Set(GameConfigKeys::JacketCacheSize, 512);
+	Set(GameConfigKeys::LuaGCBudget, 1000);
 	Set(GameConfigKeys::LeadInTime, 3000);
 	Set(GameConfigKeys::PracticeLeadInTime, 1500);
 	Set(GameConfigKeys::PracticeSetupNavEnabled, true);
@@ -191,6 +194,7 @@ void GameConfig::InitDefaults()
 	Set(GameConfigKeys::SettingsTreesOpen, 1);
 
 	SetEnum<Enum_AutoScoreScreenshotSettings>(GameConfigKeys::AutoScoreScreenshot, AutoScoreScreenshotSettings::Off);
+	Set(GameConfigKeys::ScreenshotCompressionLevel, 6);
 
 	Set(GameConfigKeys::EditorPath, "PathToEditor");
 	Set(GameConfigKeys::EditorParamsFormat, "%s");
@@ -0,0 +1,354 @@
+#include "stdafx.h"
+#include "JacketCache.hpp"
+#include "Application.hpp"
+#include <Shared/Files.hpp>
+#include <Shared/Jobs.hpp>
+
+#ifndef GL_COMPRESSED_RGB_S3TC_DXT1_EXT
+#define GL_COMPRESSED_RGB_S3TC_DXT1_EXT 0x83F0
+#endif
+
+static const uint32 jacketCacheMagic = 0x31434A55; // "UJC1"
+static const uint32 jacketCacheVersion = 1;
+
+bool JacketCache::m_enabled = false;
+
+void JacketCache::Init(size_t maxSize)
+{
+	m_enabled = false;
+#ifndef EMBEDDED
+	int32 numExtensions = 0;
+	glGetIntegerv(GL_NUM_EXTENSIONS, &numExtensions);
+	for (int32 i = 0; i < numExtensions; i++)
+	{
+		const char *extension = (const char *)glGetStringi(GL_EXTENSIONS, i);
+		if (extension && strcmp(extension, "GL_EXT_texture_compression_s3tc") == 0)
+		{
+			m_enabled = true;
+			break;
+		}
+	}
+#endif
+
+	if (m_enabled)
+	{
+		Path::CreateDir(Path::Absolute("jacketcache"));
+
+		// Scanning a large cache shouldn't delay startup, this is not an IO job
+		// so it doesn't hold up skin and screen IO that is waiting for the IO thread
+		Job pruneJob = JobBase::CreateLambda([maxSize]()
+		{
+			m_Prune(maxSize);
+			return true;
+		});
+		g_jobSheduler->Queue(pruneJob);
+	}
+	else
+		Log("Compressed textures not supported, jacket cache disabled", Logger::Severity::Info);
+}
+
+bool JacketCache::m_IsEntryValid(const String &cachePath)
+{
+	File file;
+	if (!file.OpenRead(cachePath))
+		return false;
+
+	uint32 magic = 0, version = 0, pathLength = 0;
+	uint64 lastWriteTime = 0;
+	Vector2i size;
+	file.Read(&magic, sizeof(magic));
+	file.Read(&version, sizeof(version));
+	if (magic != jacketCacheMagic || version != jacketCacheVersion)
+		return false;
+
+	file.Read(&lastWriteTime, sizeof(lastWriteTime));
+	file.Read(&size, sizeof(size));
+	file.Read(&pathLength, sizeof(pathLength));
+	if (pathLength == 0 || pathLength > file.GetSize())
+		return false;
+
+	String imagePath;
+	imagePath.resize(pathLength);
+	file.Read(&imagePath[0], pathLength);
+	// Removed images have no write time either
+	return lastWriteTime == File::GetLastWriteTime(imagePath);
+}
+
+void JacketCache::m_Prune(size_t maxSize)
+{
+	struct CacheFile
+	{
+		String path;
+		uint64 lastWriteTime;
+		size_t size;
+	};
+	Vector<CacheFile> files;
+	size_t totalSize = 0;
+	uint32 removed = 0;
+
+	for (const FileInfo &info : Files::ScanFiles(Path::Absolute("jacketcache"), "bc1"))
+	{
+		// Entries of removed or changed images can never be loaded again
+		if (!m_IsEntryValid(info.fullPath))
+		{
+			if (Path::Delete(info.fullPath))
+				removed++;
+			continue;
+		}
+
+		File file;
+		if (!file.OpenRead(info.fullPath))
+			continue;
+		files.Add({ info.fullPath, info.lastWriteTime, file.GetSize() });
+		totalSize += files.back().size;
+	}
+
+	// Remove the entries that were stored first until the cache fits
+	files.Sort([](const CacheFile &a, const CacheFile &b) { return a.lastWriteTime < b.lastWriteTime; });
+	for (const CacheFile &file : files)
+	{
+		if (totalSize <= maxSize)
+			break;
+		if (Path::Delete(file.path))
+		{
+			totalSize -= file.size;
+			removed++;
+		}
+	}
+
+	if (removed > 0)
+		Logf("Removed %u jacket cache entries, %.1f MB left", Logger::Severity::Info, removed, totalSize / (1024.0 * 1024.0));
+}
+
+bool JacketCache::IsEnabled()
+{
+	return m_enabled;
+}
+
+bool JacketCache::Load(const String &imagePath, Vector2i targetSize, Entry &out)
+{
+	File file;
+	if (!file.OpenRead(m_GetCachePath(imagePath, targetSize)))
+		return false;
+
+	uint32 magic = 0, version = 0, pathLength = 0, dataSize = 0;
+	uint64 lastWriteTime = 0;
+	Vector2i size;
+	file.Read(&magic, sizeof(magic));
+	file.Read(&version, sizeof(version));
+	if (magic != jacketCacheMagic || version != jacketCacheVersion)
+		return false;
+
+	file.Read(&lastWriteTime, sizeof(lastWriteTime));
+	file.Read(&size, sizeof(size));
+	file.Read(&pathLength, sizeof(pathLength));
+	if (pathLength != imagePath.size() || lastWriteTime != File::GetLastWriteTime(imagePath))
+		return false;
+
+	// The file name is a hash, make sure this really is the same image
+	String storedPath;
+	storedPath.resize(pathLength);
+	file.Read(&storedPath[0], pathLength);
+	if (storedPath != imagePath)
+		return false;
+
+	file.Read(&dataSize, sizeof(dataSize));
+	if (size.x <= 0 || size.y <= 0 || dataSize != GetCompressedSize(size))
+		return false;
+
+	out.size = size;
+	out.blocks.resize(dataSize);
+	return file.Read(out.blocks.data(), dataSize) == dataSize;
+}
+
+bool JacketCache::Store(const String &imagePath, Vector2i targetSize, const Image &image, Entry &out)
+{
+	const Vector2i size = image->GetSize();
+	const Colori *bits = image->GetBits();
+	if (size.x <= 0 || size.y <= 0)
+		return false;
+
+	// BC1 only has 1 bit alpha, keep transparent images uncompressed
+	for (int32 i = 0; i < size.x * size.y; i++)
+	{
+		if (bits[i].w != 255)
+			return false;
+	}
+
+	const int32 blocksX = (size.x + 3) / 4;
+	const int32 blocksY = (size.y + 3) / 4;
+	out.size = size;
+	out.blocks.resize(GetCompressedSize(size));
+	uint8 *dst = out.blocks.data();
+	Colori block[16];
+	for (int32 by = 0; by < blocksY; by++)
+	{
+		for (int32 bx = 0; bx < blocksX; bx++)
+		{
+			// Edge blocks repeat the last row/column
+			for (int32 y = 0; y < 4; y++)
+			{
+				int32 sy = Math::Min(by * 4 + y, size.y - 1);
+				for (int32 x = 0; x < 4; x++)
+				{
+					int32 sx = Math::Min(bx * 4 + x, size.x - 1);
+					block[y * 4 + x] = bits[sy * size.x + sx];
+				}
+			}
+			m_CompressBlock(block, dst);
+			dst += 8;
+		}
+	}
+
+	// Write to a temporary file first so an interrupted write never leaves a broken entry
+	const String cachePath = m_GetCachePath(imagePath, targetSize);
+	const String tempPath = cachePath + ".tmp";
+	{
+		File file;
+		if (!file.OpenWrite(tempPath))
+			return true; // Still usable, just not cached
+
+		uint64 lastWriteTime = File::GetLastWriteTime(imagePath);
+		uint32 pathLength = (uint32)imagePath.size();
+		uint32 dataSize = (uint32)out.blocks.size();
+		file.Write(&jacketCacheMagic, sizeof(jacketCacheMagic));
+		file.Write(&jacketCacheVersion, sizeof(jacketCacheVersion));
+		file.Write(&lastWriteTime, sizeof(lastWriteTime));
+		file.Write(&size, sizeof(size));
+		file.Write(&pathLength, sizeof(pathLength));
+		file.Write(imagePath.data(), pathLength);
+		file.Write(&dataSize, sizeof(dataSize));
+		file.Write(out.blocks.data(), dataSize);
+	}
+	Path::Rename(tempPath, cachePath, true);
+	return true;
+}
+
+size_t JacketCache::GetCompressedSize(Vector2i size)
+{
+	return (size_t)((size.x + 3) / 4) * (size_t)((size.y + 3) / 4) * 8;
+}
+
+uint32 JacketCache::GetTextureFormat()
+{
+	return GL_COMPRESSED_RGB_S3TC_DXT1_EXT;
+}
+
+String JacketCache::m_GetCachePath(const String &imagePath, Vector2i targetSize)
+{
+	// FNV-1a
+	uint64 hash = 0xcbf29ce484222325ull;
+	auto HashBytes = [&](const void *data, size_t len) {
+		const uint8 *bytes = (const uint8 *)data;
+		for (size_t i = 0; i < len; i++)
+		{
+			hash ^= bytes[i];
+			hash *= 0x100000001b3ull;
+		}
+	};
+	HashBytes(imagePath.data(), imagePath.size());
+	HashBytes(&targetSize, sizeof(targetSize));
+
+	return Path::Absolute(Utility::Sprintf("jacketcache/%016llx.bc1", (unsigned long long)hash));
+}
+
+void JacketCache::m_CompressBlock(const Colori *pixels, uint8 *out)
+{
+	// Bounding box of the block colors
+	int32 minColor[3] = {255, 255, 255};
+	int32 maxColor[3] = {0, 0, 0};
+	int32 mean[3] = {0, 0, 0};
+	for (int32 i = 0; i < 16; i++)
+	{
+		const uint8 *c = (const uint8 *)&pixels[i];
+		for (int32 j = 0; j < 3; j++)
+		{
+			minColor[j] = Math::Min(minColor[j], (int32)c[j]);
+			maxColor[j] = Math::Max(maxColor[j], (int32)c[j]);
+			mean[j] += c[j];
+		}
+	}
+
+	// Use the diagonal of the box that follows the correlation with the channel of the largest range
+	int32 mainChannel = 0;
+	for (int32 j = 1; j < 3; j++)
+	{
+		if (maxColor[j] - minColor[j] > maxColor[mainChannel] - minColor[mainChannel])
+			mainChannel = j;
+	}
+	for (int32 j = 0; j < 3; j++)
+		mean[j] /= 16;
+	for (int32 j = 0; j < 3; j++)
+	{
+		if (j == mainChannel)
+			continue;
+		int32 covariance = 0;
+		for (int32 i = 0; i < 16; i++)
+		{
+			const uint8 *c = (const uint8 *)&pixels[i];
+			covariance += (c[mainChannel] - mean[mainChannel]) * (c[j] - mean[j]);
+		}
+		if (covariance < 0)
+			std::swap(minColor[j], maxColor[j]);
+	}
+
+	// Inset the end points a bit, reduces the average error
+	for (int32 j = 0; j < 3; j++)
+	{
+		int32 inset = (maxColor[j] - minColor[j]) / 16;
+		maxColor[j] -= inset;
+		minColor[j] += inset;
+	}
+
+	auto To565 = [](const int32 *c) -> uint16 {
+		return (uint16)(((c[0] >> 3) << 11) | ((c[1] >> 2) << 5) | (c[2] >> 3));
+	};
+	uint16 color0 = To565(maxColor);
+	uint16 color1 = To565(minColor);
+	// color0 > color1 selects the four color mode
+	if (color0 < color1)
+		std::swap(color0, color1);
+
+	uint32 indices = 0;
+	if (color0 != color1)
+	{
+		int32 palette[4][3];
+		for (int32 p = 0; p < 2; p++)
+		{
+			uint16 v = p == 0 ? color0 : color1;
+			int32 r = (v >> 11) & 31, g = (v >> 5) & 63, b = v & 31;
+			palette[p][0] = (r << 3) | (r >> 2);
+			palette[p][1] = (g << 2) | (g >> 4);
+			palette[p][2] = (b << 3) | (b >> 2);
+		}
+		for (int32 j = 0; j < 3; j++)
+		{
+			palette[2][j] = (2 * palette[0][j] + palette[1][j]) / 3;
+			palette[3][j] = (palette[0][j] + 2 * palette[1][j]) / 3;
+		}
+
+		for (int32 i = 0; i < 16; i++)
+		{
+			const uint8 *c = (const uint8 *)&pixels[i];
+			uint32 best = 0;
+			int32 bestDistance = INT32_MAX;
+			for (uint32 p = 0; p < 4; p++)
+			{
+				int32 dr = c[0] - palette[p][0];
+				int32 dg = c[1] - palette[p][1];
+				int32 db = c[2] - palette[p][2];
+				int32 distance = dr * dr + dg * dg + db * db;
+				if (distance < bestDistance)
+				{
+					bestDistance = distance;
+					best = p;
+				}
+			}
+			indices |= best << (i * 2);
+		}
+	}
+
+	memcpy(out, &color0, 2);
+	memcpy(out + 2, &color1, 2);
+	memcpy(out + 4, &indices, 4);
+}
@@ -61,7 +61,7 @@ Mesh LaserTrackBuilder::GenerateTrackMesh(class BeatmapPlayback& playback, Laser
 		}// else ------>
 
 		// Generate positions for middle top and bottom
-		float slamLength = playback.DurationToViewDistanceAtTime(laser->time, slamDuration) * laserLengthScale;
+		float slamLength = playback.DurationToViewDistanceAtTime(laser->time, slamDuration);
 		float halfLength = slamLength * 0.5;
 		Rect3D centerMiddle = Rect3D(left, slamLength + halfLength, right, -halfLength);
 		Rect3D centerBottom = centerMiddle;
@@ -172,18 +172,18 @@ Mesh LaserTrackBuilder::GenerateTrackMesh(class BeatmapPlayback& playback, Laser
 		if(laser->prev && (laser->prev->flags & LaserObjectState::flag_Instant) != 0)
 		{
 			// Previous slam length
-			prevLength = playback.DurationToViewDistanceAtTime(laser->prev->time, slamDuration) * laserLengthScale;
+			prevLength = playback.DurationToViewDistanceAtTime(laser->prev->time, slamDuration);
 		}
 
 		Vector2 points[2];
 
 		// Connecting center points
 		points[0] = Vector2(laser->points[0] * effectiveWidth - effectiveWidth * 0.5f, prevLength); // Bottom
-		points[1] = Vector2(laser->points[1] * effectiveWidth - effectiveWidth * 0.5f, length * laserLengthScale); // Top
+		points[1] = Vector2(laser->points[1] * effectiveWidth - effectiveWidth * 0.5f, length); // Top
 		if ((laser->flags & LaserObjectState::flag_Extended) != 0)
 		{
 			points[0] = Vector2((laser->points[0] * 2.0f - 0.5f) * effectiveWidth - effectiveWidth * 0.5f, prevLength); // Bottom
-			points[1] = Vector2((laser->points[1] * 2.0f - 0.5f) * effectiveWidth - effectiveWidth * 0.5f, length * laserLengthScale); // Top
+			points[1] = Vector2((laser->points[1] * 2.0f - 0.5f) * effectiveWidth - effectiveWidth * 0.5f, length); // Top
 		}
 
 		float uMin = -0.5f;
@@ -210,6 +210,7 @@ Mesh LaserTrackBuilder::GenerateTrackMesh(class BeatmapPlayback& playback, Laser
 
 	// Cache this mesh
 	m_objectCache.Add(laser, newMesh);
+	m_AddCleanupTime(laser);
 	return newMesh;
 }
 
@@ -241,6 +242,7 @@ Mesh LaserTrackBuilder::GenerateTrackEntry(class BeatmapPlayback& playback, Lase
 
 	// Cache this mesh
 	m_cachedEntries.Add(laser, newMesh);
+	m_AddCleanupTime(laser);
 	return newMesh;
 
 }
@@ -260,19 +262,8 @@ Mesh LaserTrackBuilder::GenerateTrackExit(class BeatmapPlayback& playback, Laser
 	// Length of the tail
 	float length = (float)laserExitTextureSize.y / (float)laserExitTextureSize.x * actualLaserWidth;
 
-	// Length of this segment
-	float prevLength = 0.0f;
-	if((laser->flags & LaserObjectState::flag_Instant) != 0)
-	{
-		prevLength = playback.DurationToViewDistanceAtTime(laser->time, slamDuration) * laserLengthScale;
-	}
-	else
-	{
-		prevLength = playback.DurationToViewDistanceAtTime(laser->time, laser->duration) * laserLengthScale;
-	}
-
 	Vector<MeshGenerators::SimpleVertex> verts;
-	Rect3D pos = Rect3D(Vector2(startingX - actualLaserWidth, prevLength), Vector2(actualLaserWidth * 2, length));
+	Rect3D pos = Rect3D(Vector2(startingX - actualLaserWidth, 0.0f), Vector2(actualLaserWidth * 2, length));
 	Rect uv = Rect(-0.5f, 0.0f, 1.5f, 1.0f);
 	MeshGenerators::GenerateSimpleXYQuad(pos, uv, verts);
 
@@ -281,9 +272,18 @@ Mesh LaserTrackBuilder::GenerateTrackExit(class BeatmapPlayback& playback, Laser
 
 	// Cache this mesh
 	m_cachedExits.Add(laser, newMesh);
+	m_AddCleanupTime(laser);
 	return newMesh;
 }
 
+float LaserTrackBuilder::GetTrackExitDistance(class BeatmapPlayback& playback, LaserObjectState* laser)
+{
+	// Length of this segment
+	if((laser->flags & LaserObjectState::flag_Instant) != 0)
+		return playback.DurationToViewDistanceAtTime(laser->time, slamDuration);
+	return playback.DurationToViewDistanceAtTime(laser->time, laser->duration);
+}
+
 float LaserTrackBuilder::GetLaserLengthScaleAt(MapTime time)
 {
 	/// TODO: return scale based on speed of timing point to change horizontal laser thickness
@@ -317,8 +317,10 @@ void LaserTrackBuilder::m_RecalculateConstants()
 	effectiveWidth = m_trackWidth - m_laserWidth;
 }
 
-void LaserTrackBuilder::m_Cleanup(MapTime newTime, Map<LaserObjectState*, Mesh>& arr)
+MapTime LaserTrackBuilder::m_Cleanup(MapTime newTime, Map<LaserObjectState*, Mesh>& arr)
 {
+	MapTime nextCleanupTime = std::numeric_limits<MapTime>::max();
+
 	// Cleanup unused meshes
 	for(auto it = arr.begin(); it != arr.end();)
 	{
@@ -329,19 +331,45 @@ void LaserTrackBuilder::m_Cleanup(MapTime newTime, Map<LaserObjectState*, Mesh>&
 			it = arr.erase(it);
 			continue;
 		}
+		nextCleanupTime = Math::Min(nextCleanupTime, endTime);
 		it++;
 	}
+	return nextCleanupTime;
+}
+void LaserTrackBuilder::m_AddCleanupTime(LaserObjectState* laser)
+{
+	m_nextCleanupTime = Math::Min(m_nextCleanupTime, laser->time + laser->duration + 1000);
+}
+void LaserTrackBuilder::SetLaserLengthScale(float scale)
+{
+	if(scale == laserLengthScale)
+		return;
+	laserLengthScale = scale;
+
+	// The texture tiling of normal segments is baked with the length scale, slams and entry/exit meshes don't depend on it
+	for(auto it = m_objectCache.begin(); it != m_objectCache.end();)
+	{
+		if((it->first->flags & LaserObjectState::flag_Instant) == 0)
+			it = m_objectCache.erase(it);
+		else
+			it++;
+	}
 }
 void LaserTrackBuilder::Reset()
 {
 	m_objectCache.clear();
 	m_cachedEntries.clear();
 	m_cachedExits.clear();
+	m_nextCleanupTime = std::numeric_limits<MapTime>::max();
 	m_RecalculateConstants();
 }
 void LaserTrackBuilder::Update(MapTime newTime)
 {
-	m_Cleanup(newTime, m_objectCache);
-	m_Cleanup(newTime, m_cachedEntries);
-	m_Cleanup(newTime, m_cachedExits);
+	// Only walk the caches when a mesh has actually expired
+	if(newTime <= m_nextCleanupTime)
+		return;
+
+	m_nextCleanupTime = m_Cleanup(newTime, m_objectCache);
+	m_nextCleanupTime = Math::Min(m_nextCleanupTime, m_Cleanup(newTime, m_cachedEntries));
+	m_nextCleanupTime = Math::Min(m_nextCleanupTime, m_Cleanup(newTime, m_cachedExits));
 }
\ No newline at end of file
@@ -0,0 +1,152 @@
+#include "stdafx.h"
+#include "LuaProfiler.hpp"
+#include "lua.hpp"
+
+// Instructions between samples
+static const int sampleInterval = 1000;
+// Deeper stacks are cut off at the outermost frames
+static const int maxStackDepth = 32;
+
+LuaProfiler::LuaProfiler(lua_State* L) : m_lua(L)
+{
+	m_baseAlloc = lua_getallocf(L, &m_baseAllocData);
+	lua_setallocf(L, &LuaProfiler::m_Alloc, this);
+	lua_sethook(L, &LuaProfiler::m_Hook, LUA_MASKCALL | LUA_MASKRET | LUA_MASKCOUNT, sampleInterval);
+}
+LuaProfiler::~LuaProfiler()
+{
+	lua_sethook(m_lua, nullptr, 0, 0);
+	lua_setallocf(m_lua, m_baseAlloc, m_baseAllocData);
+}
+
+void LuaProfiler::EndFrame()
+{
+	m_frame.memoryUsed = (size_t)lua_gc(m_lua, LUA_GCCOUNT, 0) * 1024 + (size_t)lua_gc(m_lua, LUA_GCCOUNTB, 0);
+	m_lastFrame = m_frame;
+	m_frame = FrameStats();
+	// Errors unwind without return hooks, nothing is running between frames
+	m_callDepth = 0;
+
+	int64 windowTime = m_functionTimer.Milliseconds();
+	if (windowTime >= 1000)
+	{
+		float scale = 1000.0f / (float)windowTime;
+		m_lastFunctionTimes = std::move(m_functionTimes);
+		m_functionTimes.clear();
+		for (auto& f : m_lastFunctionTimes)
+			f.second *= scale;
+		m_functionTimer.Restart();
+	}
+}
+
+const LuaProfiler::FrameStats& LuaProfiler::GetLastFrameStats() const
+{
+	return m_lastFrame;
+}
+
+Vector<LuaProfiler::FunctionTime> LuaProfiler::GetTopFunctions(size_t count) const
+{
+	Vector<FunctionTime> functions;
+	for (auto& f : m_lastFunctionTimes)
+		functions.Add({ f.first, f.second });
+	functions.Sort([](const FunctionTime& a, const FunctionTime& b) { return a.time > b.time; });
+	if (functions.size() > count)
+		functions.resize(count);
+	return functions;
+}
+
+bool LuaProfiler::WriteCollapsedStacks(const String& path) const
+{
+	File file;
+	if (!file.OpenWrite(path))
+		return false;
+
+	String text;
+	for (auto& stack : m_stackTimes)
+		text += Utility::Sprintf("%s %llu\n", stack.first, (unsigned long long)stack.second);
+	return file.Write(text.data(), text.size()) == text.size();
+}
+
+void LuaProfiler::m_Hook(lua_State* L, lua_Debug* ar)
+{
+	void* ud;
+	lua_getallocf(L, &ud);
+	LuaProfiler* profiler = (LuaProfiler*)ud;
+
+	switch (ar->event)
+	{
+	case LUA_HOOKCALL:
+		// Entered from the host, time before this was not spent in lua
+		if (profiler->m_callDepth++ == 0)
+			profiler->m_sampleTimer.Restart();
+		break;
+	case LUA_HOOKRET:
+		// Returning to the host
+		if (profiler->m_callDepth > 0 && --profiler->m_callDepth == 0)
+			profiler->m_AddTime(L);
+		break;
+	case LUA_HOOKCOUNT:
+		profiler->m_AddTime(L);
+		break;
+	default:
+		break;
+	}
+}
+
+void* LuaProfiler::m_Alloc(void* ud, void* ptr, size_t osize, size_t nsize)
+{
+	LuaProfiler* profiler = (LuaProfiler*)ud;
+	void* ret = profiler->m_baseAlloc(profiler->m_baseAllocData, ptr, osize, nsize);
+
+	// osize holds the type of the object being created when ptr is null
+	size_t oldSize = ptr ? osize : 0;
+	if (nsize == 0 || (ret && nsize < oldSize))
+	{
+		profiler->m_frame.freedBytes += oldSize - nsize;
+	}
+	else if (ret)
+	{
+		if (!ptr)
+			profiler->m_frame.allocations++;
+		profiler->m_frame.allocatedBytes += nsize - oldSize;
+	}
+	return ret;
+}
+
+void LuaProfiler::m_AddTime(lua_State* L)
+{
+	float elapsed = (float)m_sampleTimer.Microseconds();
+
+	// Collect the stack from the innermost function outwards
+	Vector<String> frames;
+	lua_Debug ar;
+	for (int level = 0; level < maxStackDepth && lua_getstack(L, level, &ar); level++)
+	{
+		lua_getinfo(L, "Sn", &ar);
+		if (ar.what[0] == 'C')
+			frames.Add(ar.name ? ar.name : "?");
+		else if (ar.what[0] == 'm')
+			frames.Add(Utility::Sprintf("main chunk (%s)", ar.short_src));
+		else
+			frames.Add(Utility::Sprintf("%s (%s:%d)", ar.name ? ar.name : "?", ar.short_src, ar.linedefined));
+	}
+	if (frames.empty())
+	{
+		m_sampleTimer.Restart();
+		return;
+	}
+
+	String stack;
+	for (auto it = frames.rbegin(); it != frames.rend(); it++)
+	{
+		if (!stack.empty())
+			stack += ";";
+		stack += *it;
+	}
+	m_stackTimes[stack] += (uint64)elapsed;
+	m_functionTimes[frames[0]] += elapsed / 1000.0f;
+	m_frame.luaTime += elapsed / 1000.0f;
+
+	// Restarted last so the time spent here is not billed to the next sample
+	m_sampleTimer.Restart();
+}
@@ -905,7 +905,8 @@ void MultiplayerScreen::Tick(float deltaTime)
 
 
 
-	if (m_dbUpdateTimer.Milliseconds() > 500)
+	// Work through a backlog of changes every frame, otherwise only poll for new ones
+	if (m_mapDatabase->HasPendingChanges() || m_dbUpdateTimer.Milliseconds() > 500)
 	{
 		m_mapDatabase->Update();
 		m_dbUpdateTimer.Restart();
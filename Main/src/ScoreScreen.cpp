@@ -16,6 +16,7 @@
 #include <Beatmap/TinySHA1.hpp>
 #include "MultiplayerScreen.hpp"
 #include "ChatOverlay.hpp"
+#include "Shared/Jobs.hpp"
 
 class ScoreScreen_Impl : public ScoreScreen
 {
@@ -50,6 +51,7 @@ private:
 	bool m_removed = false;
 	bool m_hasScreenshot = false;
 	bool m_hasRendered = false;
+	Ref<ScreenshotSaver> m_screenshot;
     MultiplayerScreen* m_multiplayer = NULL;
 	String m_playerName;
 	String m_playerId;
@@ -260,7 +262,7 @@ public:
 		if (ChartIndex* chart = game->GetChartIndex())
 		{
 			m_chartIndex = chart;
-			m_highScores = chart->scores;
+			m_highScores = chart->GetAllScores();
 		}
 
 		// XXX add data for multi
@@ -712,6 +714,9 @@ public:
 	}
 	virtual void Tick(float deltaTime) override
 	{
+		if (m_screenshot)
+			m_screenshot->Update();
+
 		m_timeOnScreen += deltaTime;
 
 		if (!m_hasScreenshot && m_hasRendered && !IsSuspended())
@@ -778,6 +783,10 @@ public:
 
 	void Capture()
 	{
+		// Only one screenshot in flight at a time
+		if (m_screenshot && !m_screenshot->IsDone())
+			return;
+
 		auto luaPopInt = [this]
 		{
 			int a = lua_tonumber(m_lua, lua_gettop(m_lua));
@@ -820,18 +829,14 @@ public:
 			}
 		}
 		Vector2i size(w, h);
-		Image screenshot = ImageRes::Screenshot(g_gl, size, { x,y });
+		// The pixels are picked up in Tick once the GPU has copied them
 		String screenshotPath = "screenshots/" + Shared::Time::Now().ToString() + ".png";
-		if (screenshot.get() != nullptr)
-		{
-			screenshot->SavePNG(screenshotPath);
-			screenshot.reset();
-		}
-		else 
-		{
-			screenshotPath = "Failed to capture screenshot";
-		}
-
+		int32 compressionLevel = g_gameConfig.GetInt(GameConfigKeys::ScreenshotCompressionLevel);
+		m_screenshot = Ref<ScreenshotSaver>(new ScreenshotSaver(g_gl, g_jobSheduler, screenshotPath, size, { x,y }, compressionLevel));
+		m_screenshot->OnSaved.Add(this, &ScoreScreen_Impl::m_OnScreenshotCaptured);
+	}
+	void m_OnScreenshotCaptured(const String& screenshotPath)
+	{
 		lua_getglobal(m_lua, "screenshot_captured");
 		if (lua_isfunction(m_lua, -1))
 		{
@@ -23,6 +23,7 @@
 #include "PreviewPlayer.hpp"
 #include "ItemSelectionWheel.hpp"
 #include "Audio/OffsetComputer.hpp"
+#include "nanovg.h"
 
 /*
 	Song preview player with fade-in/out
@@ -975,6 +976,8 @@ private:
 
 	bool m_hasCollDiag = false;
 	bool m_transitionedToGame = false;
+	// Render stats overlay, enabled with -debug
+	bool m_renderDebugHUD = false;
 	int32 m_lastMapIndex = -1;
 
 	DBUpdateScreen* m_dbUpdateScreen = nullptr;
@@ -1166,6 +1169,7 @@ public:
 
 	bool Init() override
 	{
+		m_renderDebugHUD = g_application->GetAppCommandLine().Contains("-debug");
 		return true;
 	}
 	~SongSelect_Impl()
@@ -1598,7 +1602,8 @@ public:
 	}
 	void Tick(float deltaTime) override
 	{
-		if (m_dbUpdateTimer.Milliseconds() > 500)
+		// Work through a backlog of changes every frame, otherwise only poll for new ones
+		if (m_mapDatabase->HasPendingChanges() || m_dbUpdateTimer.Milliseconds() > 500)
 		{
 			m_mapDatabase->Update();
 			m_dbUpdateTimer.Restart();
@@ -1645,6 +1650,25 @@ public:
 
 		if (m_multiplayer)
 			m_multiplayer->GetChatOverlay()->Render(deltaTime);
+
+		if (m_renderDebugHUD)
+			m_RenderDebugHUD();
+	}
+
+	void m_RenderDebugHUD()
+	{
+		const RenderStats& renderStats = g_gl->GetLastFrameRenderStats();
+		String statsText = Utility::Sprintf("Draw calls: %u | Material: %u, Mesh: %u, Blend: %u changes | Glyph uploads: %u | Texture uploads: %u KB",
+			renderStats.drawCalls, renderStats.materialChanges, renderStats.meshChanges, renderStats.blendChanges,
+			renderStats.glyphUploads, renderStats.textureUploadBytes / 1024);
+		NVGcontext* vg = g_application->GetVGContext();
+		nvgReset(vg);
+		nvgBeginPath(vg);
+		nvgFontFace(vg, "fallback");
+		nvgFontSize(vg, 16);
+		nvgTextAlign(vg, NVG_ALIGN_LEFT | NVG_ALIGN_BOTTOM);
+		nvgFillColor(vg, nvgRGB(0, 200, 255));
+		nvgText(vg, 5, g_resolution.y - 5, statsText.c_str(), 0);
 	}
 
 	void TickNavigation(float deltaTime)
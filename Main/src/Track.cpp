@@ -7,7 +7,6 @@
 #include <Beatmap/BeatmapPlayback.hpp>
 #include <Beatmap/BeatmapObjects.hpp>
 #include "AsyncAssetLoader.hpp"
-#include <unordered_set>
 
 const float Track::trackWidth = 1.0f;
 const float Track::buttonWidth = 1.0f / 6;
@@ -361,6 +360,7 @@ void Track::DrawLaserBase(RenderQueue& rq, class BeatmapPlayback& playback, cons
 			// Get the length of this laser segment
 			Transform laserTransform = trackOrigin;
 			laserTransform *= Transform::Translation(Vector3{ 0.0f, posmult * position, 0.0f });
+			laserTransform *= Transform::Scale({ 1.0f, posmult, 1.0f });
 
 			if (laserMesh)
 			{
@@ -411,7 +411,7 @@ void Track::DrawBase(class RenderQueue& rq)
 	}
 	
 }
-void Track::DrawObjectState(RenderQueue& rq, class BeatmapPlayback& playback, ObjectState* obj, bool active, const std::unordered_set<MapTime> chipFXTimes[2])
+void Track::DrawObjectState(RenderQueue& rq, class BeatmapPlayback& playback, ObjectState* obj, bool active)
 {
 	// Calculate height based on time on current track
 	float viewRange = GetViewRange();
@@ -435,7 +435,6 @@ void Track::DrawObjectState(RenderQueue& rq, class BeatmapPlayback& playback, Ob
 		{
 			width = buttonWidth;
 			xposition = buttonTrackWidth * -0.5f + width * mobj->button.index;
-			int fxIdx = 0;
 			if (mobj->button.index < 2)
 			{
 				xposition -= 0.5 * centerSplit * buttonWidth;
@@ -443,9 +442,8 @@ void Track::DrawObjectState(RenderQueue& rq, class BeatmapPlayback& playback, Ob
 			else 
 			{
 				xposition += 0.5 * centerSplit * buttonWidth;
-				fxIdx = 1;
 			}
-			if (!isHold && chipFXTimes[fxIdx].count(mobj->time))
+			if (!isHold && mobj->button.overlapsFXChip)
 			{
 				xscale = m_btOverFxScale;
 				xposition += width * ((1.0 - xscale) / 2.0);
@@ -510,23 +508,38 @@ void Track::DrawObjectState(RenderQueue& rq, class BeatmapPlayback& playback, Ob
 		params.SetParameter("suddenFadeWindow", suddenFadewindow); // Sudden cutoff (% of track)
 
 
+		if(!isHold)
+		{
+			// Chips only differ in position, add them to the batch for this texture
+			uint32 batchType = mobj->button.index < 4 ? 0 : 1;
+			ChipBatch& batch = m_chipBatches[batchType][mobj->button.hasSample ? 1 : 0];
+			Shared::Rect3D chipRect = Shared::Rect3D(Vector2(xposition, buttonPos.y), Vector2(width * xscale, length * scale));
+			MeshGenerators::GenerateSimpleXYQuad(chipRect, Rect(0.0f, 0.0f, 1.0f, 1.0f), batch.verts);
+			m_hasChipBatches = true;
+			return;
+		}
+
 		buttonTransform *= Transform::Scale({ xscale, scale, 1.0f });
 		rq.Draw(buttonTransform, mesh, mat, params);
 	}
 	else if(obj->type == ObjectType::Laser) // Draw laser
 	{
-		
+		// Lasers are drawn on top of chips
+		if(m_hasChipBatches)
+			DrawObjectBatches(rq);
+
 
 		position = playback.TimeToViewDistance(obj->time);
 		float posmult = trackLength / (m_viewRange * laserSpeedOffset);
 		LaserObjectState* laser = (LaserObjectState*)obj;
 
 		// Draw segment function
-		auto DrawSegment = [&](Mesh mesh, Texture texture, int part)
+		// lengthScale is applied to meshes that are generated in view distance units, offset is in track units
+		auto DrawSegment = [&](Mesh mesh, Texture texture, int part, float lengthScale, float offset)
 		{
 			MaterialParameterSet laserParams;
-			laserParams.SetParameter("trackPos", posmult * position / trackLength);
-			laserParams.SetParameter("trackScale", 1.0f / trackLength);
+			laserParams.SetParameter("trackPos", (posmult * position + offset) / trackLength);
+			laserParams.SetParameter("trackScale", lengthScale / trackLength);
 			laserParams.SetParameter("hiddenCutoff", hiddenCutoff); // Hidden cutoff (% of track)
 			laserParams.SetParameter("hiddenFadeWindow", hiddenFadewindow); // Hidden cutoff (% of track)
 			laserParams.SetParameter("suddenCutoff", suddenCutoff); // Hidden cutoff (% of track)
@@ -548,8 +561,9 @@ void Track::DrawObjectState(RenderQueue& rq, class BeatmapPlayback& playback, Ob
 
 			// Get the length of this laser segment
 			Transform laserTransform = trackOrigin;
-			laserTransform *= Transform::Translation(Vector3{ 0.0f, posmult * position,
+			laserTransform *= Transform::Translation(Vector3{ 0.0f, posmult * position + offset,
 				0.0f });
+			laserTransform *= Transform::Scale({ 1.0f, lengthScale, 1.0f });
 
 			// Set laser color
 			laserParams.SetParameter("color", laserColors[laser->index]);
@@ -564,21 +578,59 @@ void Track::DrawObjectState(RenderQueue& rq, class BeatmapPlayback& playback, Ob
 		if(!laser->prev)
 		{
 			Mesh laserTail = m_laserTrackBuilder[laser->index]->GenerateTrackEntry(playback, laser);
-			DrawSegment(laserTail, laserTailTextures[laser->index], 1);
+			DrawSegment(laserTail, laserTailTextures[laser->index], 1, 1.0f, 0.0f);
 		}
 
 		// Body
 		Mesh laserMesh = m_laserTrackBuilder[laser->index]->GenerateTrackMesh(playback, laser);
-		DrawSegment(laserMesh, laserTextures[laser->index], 0);
+		DrawSegment(laserMesh, laserTextures[laser->index], 0, posmult, 0.0f);
 
 		// Draw exit?
 		if(!laser->next && (laser->flags & LaserObjectState::flag_Instant) != 0) // Only draw exit on slams
 		{
 			Mesh laserTail = m_laserTrackBuilder[laser->index]->GenerateTrackExit(playback, laser);
-			DrawSegment(laserTail, laserTailTextures[2 + laser->index], 2);
+			float exitOffset = posmult * m_laserTrackBuilder[laser->index]->GetTrackExitDistance(playback, laser);
+			DrawSegment(laserTail, laserTailTextures[2 + laser->index], 2, 1.0f, exitOffset);
 		}
 	}
 }
+void Track::DrawObjectBatches(RenderQueue& rq)
+{
+	if(!m_hasChipBatches)
+		return;
+
+	// FX chips are drawn below normal chips
+	for(int32 type = 1; type >= 0; type--)
+	{
+		for(uint32 hasSample = 0; hasSample < 2; hasSample++)
+		{
+			ChipBatch& batch = m_chipBatches[type][hasSample];
+			if(batch.verts.empty())
+				continue;
+
+			if(!batch.mesh)
+			{
+				batch.mesh = MeshRes::Create(g_gl);
+				batch.mesh->SetPrimitiveType(PrimitiveType::TriangleList);
+			}
+			batch.mesh->SetData(batch.verts);
+			batch.verts.clear();
+
+			// Vertices are already in track space
+			MaterialParameterSet params;
+			params.SetParameter("hasSample", (int)hasSample);
+			params.SetParameter("mainTex", type == 0 ? buttonTexture : fxbuttonTexture);
+			params.SetParameter("trackPos", 0.0f);
+			params.SetParameter("trackScale", 1.0f / trackLength);
+			params.SetParameter("hiddenCutoff", hiddenCutoff); // Hidden cutoff (% of track)
+			params.SetParameter("hiddenFadeWindow", hiddenFadewindow); // Hidden cutoff (% of track)
+			params.SetParameter("suddenCutoff", suddenCutoff); // Sudden cutoff (% of track)
+			params.SetParameter("suddenFadeWindow", suddenFadewindow); // Sudden cutoff (% of track)
+			rq.Draw(trackOrigin, batch.mesh, buttonMaterial, params);
+		}
+	}
+	m_hasChipBatches = false;
+}
 void Track::DrawOverlays(class RenderQueue& rq)
 {
 	// Draw button hit effect sprites
@@ -714,14 +766,10 @@ void Track::SetViewRange(float newRange)
 	{
 		m_viewRange = newRange;
 
-		// Update view range
+		// Only the texture tiling of normal laser segments depends on the view range, the other meshes are kept
 		float newLaserLengthScale = trackLength / (m_viewRange * laserSpeedOffset);
-		m_laserTrackBuilder[0]->laserLengthScale = newLaserLengthScale;
-		m_laserTrackBuilder[1]->laserLengthScale = newLaserLengthScale;
-
-		// Reset laser tracks cause these won't be correct anymore
-		m_laserTrackBuilder[0]->Reset();
-		m_laserTrackBuilder[1]->Reset();
+		m_laserTrackBuilder[0]->SetLaserLengthScale(newLaserLengthScale);
+		m_laserTrackBuilder[1]->SetLaserLengthScale(newLaserLengthScale);
 	}
 }
 
@@ -390,6 +390,9 @@ public:
 		m_lamdasToRemove.clear();
 		m_handlesToRemove.clear();
 
+		// The previous screen's garbage is collected while the transition covers the screen
+		g_application->CollectLuaGarbage();
+
 		m_loadComplete = true;
 		if ((!m_isGame && m_lua == nullptr) || (m_isGame && m_songlua == nullptr))
 			m_transition = End;
@@ -36,6 +36,8 @@
 #include <Graphics/Image.hpp>
 #include <Graphics/ImageLoader.hpp>
 #include <Graphics/Texture.hpp>
+#include <Graphics/TextureUploader.hpp>
+#include <Graphics/ScreenCapture.hpp>
 #include <Graphics/Material.hpp>
 #include <Graphics/Mesh.hpp>
 #include <Graphics/RenderQueue.hpp>
@@ -0,0 +1,35 @@
+#pragma once
+#include "Shared/Unique.hpp"
+#include "Shared/String.hpp"
+#include "Shared/Set.hpp"
+#include "Shared/Vector.hpp"
+
+/*
+	Watches folders and all of their subfolders for added, removed or modified files
+	Uses inotify on linux, otherwise (or when running out of watches) the write times of the folders and the files directly in them are polled
+*/
+class FileWatcher : Unique
+{
+private:
+	class FileWatcher_Impl* m_impl = nullptr;
+public:
+	FileWatcher();
+	~FileWatcher();
+
+	// Starts watching a folder and all of its subfolders
+	// Additional interruptible flag can contain a boolean which can interrupt the folder enumeration when set to true
+	void AddFolder(const String& folder, bool* interrupt = nullptr);
+	// Starts watching the given folders, without enumerating their subfolders
+	// Use this when the folder tree was already walked, e.g. with Files::ScanFilesRecursive
+	void AddFolders(const Vector<String>& folders);
+	// Stops watching all folders
+	void Clear();
+
+	// Adds the folders that had changes since the last call to changedFolders
+	// returns true if changes were lost and everything should be checked again
+	// Can be called from another thread than AddFolder, returns without changes while folders are being added
+	bool PollChanges(Set<String>& changedFolders);
+
+	// The amount of folders checked per call to PollChanges when polling write times
+	size_t pollBatchSize = 64;
+};
@@ -35,7 +35,8 @@ public:
 	// Finds files in a given folder, recursively
 	// uses the given extension filters if specified (results will be returned in a map with given exts as keys)
 	// Additional interruptible flag can contain a boolean which can interrupt the search when set to true
-	static Map<String, Vector<FileInfo>> ScanFilesRecursive(const String& folder, const Vector<String>& extFilters, bool* interrupt = nullptr);
+	// All visited folders, including the root, are added to visitedFolders if specified
+	static Map<String, Vector<FileInfo>> ScanFilesRecursive(const String& folder, const Vector<String>& extFilters, bool* interrupt = nullptr, Vector<String>* visitedFolders = nullptr);
 
 	// Finds files in a given folder
 	// uses the given extension filter if specified
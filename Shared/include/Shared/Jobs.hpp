@@ -5,6 +5,7 @@
 #include "Shared/Unique.hpp"
 #include "Shared/Ref.hpp"
 #include "Shared/Delegate.hpp"
+#include <atomic>
 
 /*
 	Additional job flags,
@@ -54,7 +55,8 @@ public:
 
 private:
 	bool m_ret = false;
-	bool m_finished = false;
+	// Set by the job thread, may be polled from any thread
+	std::atomic<bool> m_finished = { false };
 	class JobSheduler_Impl* m_sheduler = nullptr;
 	friend class JobSheduler_Impl;
 };
@@ -0,0 +1,287 @@
+#include "stdafx.h"
+#include "FileWatcher.hpp"
+#include "Files.hpp"
+#include "File.hpp"
+#include "Path.hpp"
+#include "Log.hpp"
+#include "List.hpp"
+#include "Math.hpp"
+#include <mutex>
+
+#ifndef _WIN32
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <dirent.h>
+#endif
+
+#ifdef __linux__
+#include <sys/inotify.h>
+#include <unistd.h>
+#include <errno.h>
+#endif
+
+// Adds a folder and its subfolders to the output, only the direct subfolders when not recursing
+static void _ListFolders(const String& rootFolder, Vector<String>& out, bool recurse, bool* interrupt)
+{
+	List<String> folderQueue;
+	folderQueue.AddBack(rootFolder);
+	while(!folderQueue.empty() && (!interrupt || !*interrupt))
+	{
+		String folder = folderQueue.front();
+		folderQueue.pop_front();
+		out.Add(folder);
+		if(!recurse && folder != rootFolder)
+			continue;
+
+#ifdef _WIN32
+		for(FileInfo& info : Files::ScanFiles(folder))
+		{
+			if(info.type == FileType::Folder)
+				folderQueue.AddBack(info.fullPath);
+		}
+#else
+		DIR* dir = opendir(*folder);
+		if(dir == nullptr)
+			continue;
+		while(dirent* ent = readdir(dir))
+		{
+			String filename = ent->d_name;
+			if(filename == "." || filename == "..")
+				continue;
+
+			String path = Path::Normalize(folder + Path::sep + filename);
+			bool isDir = ent->d_type == DT_DIR;
+			if(ent->d_type == DT_UNKNOWN || ent->d_type == DT_LNK)
+				isDir = Path::IsDirectory(path);
+			if(isDir)
+				folderQueue.AddBack(path);
+		}
+		closedir(dir);
+#endif
+	}
+}
+
+// Latest write time of a folder and the files directly inside it
+// The write time of a folder only changes when entries are added, removed or renamed, not when a file is modified in place
+static uint64 _GetContentsWriteTime(const String& folder)
+{
+	uint64 writeTime = File::GetLastWriteTime(folder);
+	for(const FileInfo& info : Files::ScanFiles(folder))
+	{
+		if(info.type == FileType::Regular)
+			writeTime = Math::Max(writeTime, info.lastWriteTime);
+	}
+	return writeTime;
+}
+
+class FileWatcher_Impl
+{
+public:
+	std::mutex m_lock;
+
+	// Folders that are watched by polling their write times
+	Vector<String> m_polledFolders;
+	Map<String, uint64> m_folderWriteTimes;
+	size_t m_nextPolledFolder = 0;
+
+#ifdef __linux__
+	int m_inotify = -1;
+	// Maps inotify watch descriptors to the folders they watch
+	Map<int, String> m_watches;
+	bool m_warnedWatchLimit = false;
+#endif
+
+	FileWatcher_Impl()
+	{
+#ifdef __linux__
+		m_inotify = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+		if(m_inotify < 0)
+			Logf("Failed to initialize inotify (%d), falling back to polling folders for changes", Logger::Severity::Warning, errno);
+#endif
+	}
+	~FileWatcher_Impl()
+	{
+#ifdef __linux__
+		if(m_inotify >= 0)
+			close(m_inotify);
+#endif
+	}
+
+	void AddFolders(const String& rootFolder, bool* interrupt)
+	{
+		Vector<String> folders;
+		_ListFolders(rootFolder, folders, true, interrupt);
+		for(const String& folder : folders)
+			m_AddFolder(folder);
+	}
+	void AddFolders(const Vector<String>& folders)
+	{
+		for(const String& folder : folders)
+			m_AddFolder(folder);
+	}
+
+	void Clear()
+	{
+#ifdef __linux__
+		for(auto& watch : m_watches)
+			inotify_rm_watch(m_inotify, watch.first);
+		m_watches.clear();
+#endif
+		m_polledFolders.clear();
+		m_folderWriteTimes.clear();
+		m_nextPolledFolder = 0;
+	}
+
+	bool PollChanges(Set<String>& changedFolders, size_t pollBatchSize)
+	{
+		bool lostChanges = false;
+#ifdef __linux__
+		if(m_inotify >= 0)
+			lostChanges = m_ReadEvents(changedFolders);
+#endif
+
+		// Check a limited amount of folders per call so polling stays cheap with large libraries
+		for(size_t i = 0; i < pollBatchSize && !m_polledFolders.empty(); i++)
+		{
+			if(m_nextPolledFolder >= m_polledFolders.size())
+				m_nextPolledFolder = 0;
+
+			const String folder = m_polledFolders[m_nextPolledFolder];
+			uint64& writeTime = m_folderWriteTimes[folder];
+			bool exists = Path::IsDirectory(folder);
+			uint64 newWriteTime = exists ? _GetContentsWriteTime(folder) : 0;
+			if(exists && newWriteTime == writeTime)
+			{
+				m_nextPolledFolder++;
+				continue;
+			}
+
+			changedFolders.Add(folder);
+			if(!exists)
+			{
+				m_folderWriteTimes.erase(folder);
+				m_polledFolders.erase(m_polledFolders.begin() + m_nextPolledFolder);
+				continue;
+			}
+			writeTime = newWriteTime;
+			m_nextPolledFolder++;
+
+			// Entries of the folder changed, start watching new subfolders
+			Vector<String> folders;
+			_ListFolders(folder, folders, false, nullptr);
+			for(const String& subFolder : folders)
+			{
+				if(!m_folderWriteTimes.Contains(subFolder))
+				{
+					AddFolders(subFolder, nullptr);
+					changedFolders.Add(subFolder);
+				}
+			}
+		}
+
+		return lostChanges;
+	}
+
+private:
+	void m_AddFolder(const String& folder)
+	{
+#ifdef __linux__
+		if(m_inotify >= 0)
+		{
+			int wd = inotify_add_watch(m_inotify, *folder, IN_CREATE | IN_DELETE | IN_CLOSE_WRITE | IN_ATTRIB |
+				IN_MOVED_FROM | IN_MOVED_TO | IN_DELETE_SELF | IN_ONLYDIR);
+			if(wd >= 0)
+			{
+				m_watches.Add(wd, folder);
+				return;
+			}
+			if(errno == ENOSPC && !m_warnedWatchLimit)
+			{
+				Log("Reached the inotify watch limit, polling the remaining folders for changes", Logger::Severity::Warning);
+				m_warnedWatchLimit = true;
+			}
+			if(errno != ENOSPC)
+				return;
+		}
+#endif
+		if(m_folderWriteTimes.Contains(folder))
+			return;
+		m_polledFolders.Add(folder);
+		m_folderWriteTimes.Add(folder, _GetContentsWriteTime(folder));
+	}
+
+#ifdef __linux__
+	bool m_ReadEvents(Set<String>& changedFolders)
+	{
+		bool lostChanges = false;
+		alignas(inotify_event) char buffer[4096];
+		ssize_t len;
+		while((len = read(m_inotify, buffer, sizeof(buffer))) > 0)
+		{
+			for(char* ptr = buffer; ptr < buffer + len;)
+			{
+				const inotify_event* event = (const inotify_event*)ptr;
+				ptr += sizeof(inotify_event) + event->len;
+
+				if(event->mask & IN_Q_OVERFLOW)
+				{
+					lostChanges = true;
+					continue;
+				}
+
+				String* folder = m_watches.Find(event->wd);
+				if(!folder)
+					continue;
+
+				if(event->mask & IN_IGNORED)
+				{
+					// Watched folder was removed, its parent reports the change
+					m_watches.erase(event->wd);
+					continue;
+				}
+
+				changedFolders.Add(*folder);
+				if((event->mask & IN_ISDIR) && (event->mask & (IN_CREATE | IN_MOVED_TO)) && event->len > 0)
+				{
+					// Watch folders that are copied or moved in, files in them may already exist before the watch is added
+					String subFolder = Path::Normalize(*folder + Path::sep + event->name);
+					AddFolders(subFolder, nullptr);
+					changedFolders.Add(subFolder);
+				}
+			}
+		}
+		return lostChanges;
+	}
+#endif
+};
+
+FileWatcher::FileWatcher()
+{
+	m_impl = new FileWatcher_Impl();
+}
+FileWatcher::~FileWatcher()
+{
+	delete m_impl;
+}
+void FileWatcher::AddFolder(const String& folder, bool* interrupt)
+{
+	std::lock_guard<std::mutex> lock(m_impl->m_lock);
+	m_impl->AddFolders(folder, interrupt);
+}
+void FileWatcher::AddFolders(const Vector<String>& folders)
+{
+	std::lock_guard<std::mutex> lock(m_impl->m_lock);
+	m_impl->AddFolders(folders);
+}
+void FileWatcher::Clear()
+{
+	std::lock_guard<std::mutex> lock(m_impl->m_lock);
+	m_impl->Clear();
+}
+bool FileWatcher::PollChanges(Set<String>& changedFolders)
+{
+	std::unique_lock<std::mutex> lock(m_impl->m_lock, std::try_to_lock);
+	if(!lock.owns_lock())
+		return false;
+	return m_impl->PollChanges(changedFolders, pollBatchSize);
+}
@@ -143,11 +143,15 @@ private:
 				{
 					myThread->idleDuration.Restart();
 
-					// Process a job
-					Job& peekJob = m_jobQueue.front();
-					if((peekJob->jobFlags & JobFlags::IO) != JobFlags::IO || (myThread->index != 0)) // Only perform IO on first thread
+					// Take the first job this thread can run, IO is only performed on the first thread
+					// so other jobs are not held up behind IO jobs waiting for it
+					auto jobIt = m_jobQueue.begin();
+					while(jobIt != m_jobQueue.end() && ((*jobIt)->jobFlags & JobFlags::IO) == JobFlags::IO && myThread->index != 0)
+						jobIt++;
+					if(jobIt != m_jobQueue.end())
 					{
-						myThread->activeJob = m_jobQueue.PopFront();
+						myThread->activeJob = *jobIt;
+						m_jobQueue.erase(jobIt);
 						m_lock.unlock();
 
 						// Run
@@ -8,13 +8,168 @@
 #include <sys/types.h>
 #include <sys/stat.h>
 #include <dirent.h>
+#include <fcntl.h>
+#include <cstring>
+#include <algorithm>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+
+static uint64 _GetLastWriteTime(const struct stat& sb)
+{
+	#ifdef __APPLE__
+		return sb.st_mtimespec.tv_sec * (uint64)1000000000L + sb.st_mtimespec.tv_nsec;
+	#else
+		return sb.st_mtim.tv_sec * (uint64)1000000000L + sb.st_mtim.tv_nsec;
+	#endif
+}
 
-static Map<String, Vector<FileInfo>> _ScanFiles(const String& rootFolder, const Vector<String>& extFilters, bool recurse, bool* interrupt)
+// State shared between the threads scanning a folder tree
+struct ScanState
+{
+	Vector<String> fixedExts;
+	bool filterByExtension;
+	bool recurse;
+	bool* interrupt;
+
+	// Folders waiting to be scanned, subfolders are getting added to this list
+	List<String> folderQueue;
+	// Number of threads currently scanning a folder, these may still add more folders
+	size_t busyThreads = 0;
+	std::mutex lock;
+	std::condition_variable cv;
+
+	bool Interrupted() const
+	{
+		return interrupt && *interrupt;
+	}
+};
+
+// Results of a single scanning thread, one list per extension filter and one for unfiltered results
+struct ScanResult
+{
+	Vector<Vector<FileInfo>> filtered;
+	Vector<FileInfo> unfiltered;
+	Vector<String> folders;
+};
+
+static void _ScanFolder(ScanState& state, const String& folder, ScanResult& result, Vector<String>& subFolders)
+{
+	DIR* dir = opendir(*folder);
+	if(dir == nullptr)
+		return;
+	int dirFd = dirfd(dir);
+
+	dirent* ent;
+	while((ent = readdir(dir)) && !state.Interrupted())
+	{
+		const char* name = ent->d_name;
+		if(name[0] == '.' && (name[1] == '\0' || (name[1] == '.' && name[2] == '\0')))
+			continue;
+
+		// Only links and file systems without d_type need a stat to find folders
+		struct stat sb;
+		bool hasStat = false;
+		bool isDir = ent->d_type == DT_DIR;
+		bool isLink = ent->d_type == DT_LNK;
+		if(ent->d_type == DT_UNKNOWN || isLink)
+		{
+			if(fstatat(dirFd, name, &sb, 0) != 0)
+				continue;
+			hasStat = true;
+			isDir = S_ISDIR(sb.st_mode);
+		}
+
+		Vector<FileInfo>* target = &result.unfiltered;
+		if(isDir)
+		{
+			if(!state.recurse && state.filterByExtension)
+				continue;
+		}
+		else if(state.filterByExtension)
+		{
+			// Match the extension before allocating anything for the entry
+			const char* dot = strrchr(name, '.');
+			const char* ext = dot ? dot + 1 : "";
+			target = nullptr;
+			for(size_t i = 0; i < state.fixedExts.size(); i++)
+			{
+				if(state.fixedExts[i] == ext)
+				{
+					target = &result.filtered[i];
+					break;
+				}
+			}
+			if(!target)
+				continue;
+		}
+
+		String fullPath = folder + Path::sep + name;
+		// Links are resolved like the root folder was, so paths stay the same as with Path::Normalize
+		if(isLink)
+			fullPath = Path::Normalize(fullPath);
+
+		if(isDir && state.recurse)
+		{
+			// Visit sub-folder
+			subFolders.Add(std::move(fullPath));
+			continue;
+		}
+
+		if(!hasStat && fstatat(dirFd, name, &sb, 0) != 0)
+			sb = {};
+
+		FileInfo info;
+		info.fullPath = std::move(fullPath);
+		info.lastWriteTime = _GetLastWriteTime(sb);
+		info.type = isDir ? FileType::Folder : FileType::Regular;
+		target->push_back(std::move(info));
+	}
+
+	closedir(dir);
+}
+
+static void _ScanThread(ScanState& state, ScanResult& result)
+{
+	result.filtered.resize(state.fixedExts.size());
+
+	Vector<String> subFolders;
+	while(true)
+	{
+		String folder;
+		{
+			std::unique_lock<std::mutex> lock(state.lock);
+			// Done when there is nothing left to scan and no other thread can add more
+			state.cv.wait(lock, [&]() { return !state.folderQueue.empty() || state.busyThreads == 0 || state.Interrupted(); });
+			if(state.folderQueue.empty() || state.Interrupted())
+				break;
+			folder = std::move(state.folderQueue.front());
+			state.folderQueue.pop_front();
+			state.busyThreads++;
+		}
+
+		_ScanFolder(state, folder, result, subFolders);
+		if(state.recurse)
+			result.folders.push_back(std::move(folder));
+
+		{
+			std::lock_guard<std::mutex> lock(state.lock);
+			for(String& subFolder : subFolders)
+				state.folderQueue.AddBack(std::move(subFolder));
+			state.busyThreads--;
+		}
+		subFolders.clear();
+		state.cv.notify_all();
+	}
+	state.cv.notify_all();
+}
+
+static Map<String, Vector<FileInfo>> _ScanFiles(const String& rootFolder, const Vector<String>& extFilters, bool recurse, bool* interrupt, Vector<String>* visitedFolders = nullptr)
 {
 	// Found files will go in here. If there is no filter extensions or only "" then all files will have "" as their key
 	Map<String, Vector<FileInfo>> ret;
 
-	Vector<String> fixedExts;
+	ScanState state;
 	for (int i=0; i<extFilters.size(); i++)
 	{
 		// Not a reference or const bc we need a copy so we can trim it
@@ -24,7 +179,7 @@ static Map<String, Vector<FileInfo>> _ScanFiles(const String& rootFolder, const
 		ret[ext] = Vector<FileInfo>();
 
 		ext.TrimFront('.');
-		fixedExts.push_back(ext); // Remove possible leading dot
+		state.fixedExts.push_back(ext); // Remove possible leading dot
 	}
 
 	if(!Path::IsDirectory(rootFolder))
@@ -33,92 +188,43 @@ static Map<String, Vector<FileInfo>> _ScanFiles(const String& rootFolder, const
 		return ret;
 	}
 
-	// List of paths to process, subfolders are getting added to this list
-	List<String> folderQueue;
-
-	// Add / to the end
-	folderQueue.AddBack(rootFolder);
-
 	// Either if we have no exts or no exts besides an empty string
-	bool filterByExtension = extFilters.size() != 0 && !(extFilters.size() == 1 && fixedExts[0].empty());
+	state.filterByExtension = extFilters.size() != 0 && !(extFilters.size() == 1 && state.fixedExts[0].empty());
 	// Make sure the empty one is ready
-	if (!filterByExtension)
+	if (!state.filterByExtension)
 		ret[""] = Vector<FileInfo>();
 
-	while(!folderQueue.empty() && (!interrupt || !*interrupt))
+	state.recurse = recurse;
+	state.interrupt = interrupt;
+	// Only the root folder is normalized, entries are appended to it directly
+	state.folderQueue.AddBack(Path::Normalize(rootFolder));
+
+	// Folders are scanned in parallel when recursing, the calling thread takes part as well
+	size_t numThreads = 1;
+	if(recurse)
+		numThreads = std::max<size_t>(1, std::min<size_t>(std::thread::hardware_concurrency(), 8));
+	Vector<ScanResult> results(numThreads);
+	Vector<std::thread> threads;
+	for(size_t i = 1; i < numThreads; i++)
+		threads.emplace_back(_ScanThread, std::ref(state), std::ref(results[i]));
+	_ScanThread(state, results[0]);
+	for(std::thread& thread : threads)
+		thread.join();
+
+	for(ScanResult& result : results)
 	{
-		String searchPath = folderQueue.front();
-		folderQueue.pop_front();
-
-		DIR* dir = opendir(*searchPath);
-		if(dir == nullptr)
-			continue;
-
-		// Open first entry
-		dirent* ent = readdir(dir);
-		if(ent)
+		for(size_t i = 0; i < result.filtered.size(); i++)
 		{
-			// Keep scanning files in this folder
-			do
-			{
-                String filename = ent->d_name;
-
-                /// TODO: Ask linux why
-                if(filename == ".")
-                    continue;
-                if(filename == "..")
-                    continue;
-
-				FileInfo info;
-                info.fullPath = Path::Normalize(searchPath + Path::sep + filename);
-				info.lastWriteTime = File::GetLastWriteTime(info.fullPath); // linux doesn't provide this timestamp in the directory entry
-				info.type = FileType::Regular;
-				bool is_dir = (ent->d_type == DT_DIR);
-				if (ent->d_type == DT_UNKNOWN || ent->d_type == DT_LNK)
-				{
-					struct stat buffer;
-					stat(info.fullPath.c_str(), &buffer);
-					is_dir = S_ISDIR(buffer.st_mode);
-				}
-				if(is_dir)
-				{
-					if(recurse)
-					{
-						// Visit sub-folder
-						folderQueue.AddBack(info.fullPath);
-					}
-					else if(!filterByExtension)
-					{
-                        info.type = FileType::Folder;
-						ret[""].push_back(info);
-					}
-				}
-				else
-				{
-					// Check file
-					if(filterByExtension)
-					{
-						String ext = Path::GetExtension(info.fullPath);
-						for (int i = 0; i < extFilters.size(); i++)
-						{
-							const String& extFilter = fixedExts[i];
-							if (ext == extFilter)
-							{
-								const String& realExt = extFilters[i];
-								ret[realExt].push_back(info);
-								break;
-							}
-						}
-					}
-					else
-					{
-						ret[""].push_back(info);
-					}
-				}
-			} while((ent = readdir(dir)) && (!interrupt || !*interrupt));
+			Vector<FileInfo>& out = ret[extFilters[i]];
+			out.insert(out.end(), std::make_move_iterator(result.filtered[i].begin()), std::make_move_iterator(result.filtered[i].end()));
 		}
-
-		closedir(dir);
+		if(!state.filterByExtension)
+		{
+			Vector<FileInfo>& out = ret[""];
+			out.insert(out.end(), std::make_move_iterator(result.unfiltered.begin()), std::make_move_iterator(result.unfiltered.end()));
+		}
+		if(visitedFolders)
+			visitedFolders->insert(visitedFolders->end(), std::make_move_iterator(result.folders.begin()), std::make_move_iterator(result.folders.end()));
 	}
 
 	return move(ret);
@@ -128,9 +234,9 @@ Map<String, Vector<FileInfo>> Files::ScanFiles(const String& folder, const Vecto
 {
 	return _ScanFiles(folder, extFilters, false, interrupt);
 }
-Map<String, Vector<FileInfo>> Files::ScanFilesRecursive(const String& folder, const Vector<String>& extFilters, bool* interrupt)
+Map<String, Vector<FileInfo>> Files::ScanFilesRecursive(const String& folder, const Vector<String>& extFilters, bool* interrupt, Vector<String>* visitedFolders)
 {
-	return _ScanFiles(folder, extFilters, true, interrupt);
+	return _ScanFiles(folder, extFilters, true, interrupt, visitedFolders);
 }
 
 Vector<FileInfo> Files::ScanFiles(const String& folder, const String& extFilter, bool* interrupt)
@@ -143,16 +143,13 @@ uint64 File::GetLastWriteTime() const
 
 uint64 File::GetLastWriteTime(const String& path)
 {
+	// Works for folders as well and doesn't create missing files like opening a handle would
 	WString wstringPath = Utility::ConvertToWString(path);
-	HANDLE h = CreateFileW(*wstringPath,
-		GENERIC_READ, FILE_SHARE_WRITE, 0, OPEN_ALWAYS, 0, 0);
-	if(h == INVALID_HANDLE_VALUE)
+	WIN32_FILE_ATTRIBUTE_DATA data;
+	if(!GetFileAttributesExW(*wstringPath, GetFileExInfoStandard, &data))
 		return -1;
 
-	FILETIME ftCreate, ftAccess, ftWrite;
-	GetFileTime(h, &ftCreate, &ftAccess, &ftWrite);
-	CloseHandle(h);
-	return (uint64&)ftWrite;
+	return (uint64&)data.ftLastWriteTime;
 }
 
 static bool LoadResourceInternal(const char* name, const char* type, Buffer& out)
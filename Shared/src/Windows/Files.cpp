@@ -4,7 +4,7 @@
 #include "Log.hpp"
 #include "List.hpp"
 
-static Map<String, Vector<FileInfo>>  _ScanFiles(const String& rootFolder, const Vector<String>& extFilters, bool recurse, bool* interrupt)
+static Map<String, Vector<FileInfo>>  _ScanFiles(const String& rootFolder, const Vector<String>& extFilters, bool recurse, bool* interrupt, Vector<String>* visitedFolders = nullptr)
 {
 	// Found files will go in here. If there is no filter extensions or only "" then all files will have "" as their key
 	Map<String, Vector<FileInfo>> ret;
@@ -49,6 +49,8 @@ static Map<String, Vector<FileInfo>>  _ScanFiles(const String& rootFolder, const
 		HANDLE searchHandle = FindFirstFile(*searchPathW, &findDataW);
 		if(searchHandle == INVALID_HANDLE_VALUE)
 			continue;
+		if(visitedFolders)
+			visitedFolders->Add(searchPath);
 
 		String currentfolder;
 		do
@@ -113,9 +115,9 @@ Map<String, Vector<FileInfo>>Files::ScanFiles(const String& folder, const Vector
 {
 	return _ScanFiles(folder, extFilters, false, interrupt);
 }
-Map<String, Vector<FileInfo>>Files::ScanFilesRecursive(const String& folder, const Vector<String>& extFilters, bool* interrupt)
+Map<String, Vector<FileInfo>>Files::ScanFilesRecursive(const String& folder, const Vector<String>& extFilters, bool* interrupt, Vector<String>* visitedFolders)
 {
-	return _ScanFiles(folder, extFilters, true, interrupt);
+	return _ScanFiles(folder, extFilters, true, interrupt, visitedFolders);
 }
 
 Vector<FileInfo> Files::ScanFiles(const String& folder, const String& extFilter /*= String()*/, bool* interrupt)
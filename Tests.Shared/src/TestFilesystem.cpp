@@ -3,6 +3,10 @@
 #include <Tests/Tests.hpp>
 #include <Shared/Files.hpp>
 
+#ifndef _WIN32
+#include <unistd.h>
+#endif
+
 void CreateDummyFile(const String& filename)
 {
 	File file;
@@ -92,6 +96,84 @@ Test("File.ScanFiles")
 	}
 	TestEnsure(expectedPaths.empty());
 }
+// Checks that a scan returned exactly the expected paths, with the type and write time of each entry
+void EnsureScanResult(const Vector<FileInfo>& files, const Set<String>& folders, Set<String> expectedPaths)
+{
+	TestEnsure(files.size() == expectedPaths.size());
+	for(auto& file : files)
+	{
+		TestEnsure(expectedPaths.Contains(file.fullPath));
+		expectedPaths.erase(file.fullPath);
+		TestEnsure(file.type == (folders.Contains(file.fullPath) ? FileType::Folder : FileType::Regular));
+		TestEnsure(file.lastWriteTime == File::GetLastWriteTime(file.fullPath));
+	}
+	TestEnsure(expectedPaths.empty());
+}
+Test("File.ScanFilesTree")
+{
+	String root = Path::Absolute(TestBasePath + Path::sep + context.GetName() + "_TestFolder");
+	TestEnsure(Path::CreateDir(root));
+	root = Path::Normalize(root);
+	String sub1 = root + Path::sep + "Sub1";
+	String sub2 = sub1 + Path::sep + "Sub2";
+	String sub3 = root + Path::sep + "Sub3";
+	TestEnsure(Path::CreateDir(sub1));
+	TestEnsure(Path::CreateDir(sub2));
+	TestEnsure(Path::CreateDir(sub3));
+	CreateDummyFile(root + Path::sep + "a.ksh");
+	CreateDummyFile(root + Path::sep + "b.ogg");
+	CreateDummyFile(root + Path::sep + "readme");
+	CreateDummyFile(sub1 + Path::sep + "c.ksh");
+	CreateDummyFile(sub2 + Path::sep + "d.ksh");
+	CreateDummyFile(sub2 + Path::sep + "e.chal");
+
+	// Scanned through a link inside the tree, results use the resolved path
+	String linked = Path::Normalize(TestBasePath) + Path::sep + context.GetName() + "_Linked";
+	TestEnsure(Path::CreateDir(linked));
+	CreateDummyFile(linked + Path::sep + "f.ksh");
+#ifndef _WIN32
+	String link = root + Path::sep + "Link";
+	TestEnsure(symlink(*linked, *link) == 0);
+#endif
+
+	Vector<String> exts = { "ksh", ".chal" };
+	Vector<String> visitedFolders;
+	Map<String, Vector<FileInfo>> filtered = Files::ScanFilesRecursive(root, exts, nullptr, &visitedFolders);
+	Vector<FileInfo> all = Files::ScanFilesRecursive(root);
+	Vector<FileInfo> rootEntries = Files::ScanFiles(root);
+	Vector<FileInfo> rootCharts = Files::ScanFiles(root, "ksh");
+#ifndef _WIN32
+	// Removed before checking, deleting the test folder would follow the link
+	unlink(*link);
+#endif
+
+	Set<String> folders = { sub1, sub2, sub3, linked };
+	Set<String> charts = { root + Path::sep + "a.ksh", sub1 + Path::sep + "c.ksh", sub2 + Path::sep + "d.ksh" };
+	Set<String> files = { root + Path::sep + "a.ksh", root + Path::sep + "b.ogg", root + Path::sep + "readme",
+		sub1 + Path::sep + "c.ksh", sub2 + Path::sep + "d.ksh", sub2 + Path::sep + "e.chal" };
+	Set<String> expectedFolders = { root, sub1, sub2, sub3 };
+	Set<String> expectedRootEntries = { root + Path::sep + "a.ksh", root + Path::sep + "b.ogg", root + Path::sep + "readme", sub1, sub3 };
+#ifndef _WIN32
+	charts.Add(linked + Path::sep + "f.ksh");
+	files.Add(linked + Path::sep + "f.ksh");
+	expectedFolders.Add(linked);
+	expectedRootEntries.Add(linked);
+#endif
+
+	// Results are keyed by the filters as they were passed in
+	TestEnsure(filtered.size() == 2);
+	EnsureScanResult(filtered["ksh"], folders, charts);
+	EnsureScanResult(filtered[".chal"], folders, { sub2 + Path::sep + "e.chal" });
+	// Recursive scans don't list folders, only the files inside them
+	EnsureScanResult(all, folders, files);
+	// Listing a single folder includes its subfolders unless filtering by extension
+	EnsureScanResult(rootEntries, folders, expectedRootEntries);
+	EnsureScanResult(rootCharts, folders, { root + Path::sep + "a.ksh" });
+
+	TestEnsure(visitedFolders.size() == expectedFolders.size());
+	for(auto& folder : visitedFolders)
+		TestEnsure(expectedFolders.Contains(folder));
+}
 Test("File.Dir")
 {
 	String folder = TestFilename;